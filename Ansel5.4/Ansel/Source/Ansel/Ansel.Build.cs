@@ -17,7 +17,9 @@ public class Ansel : ModuleRules
 			"RenderCore",
 			"RHI",
             "NVAnselSDK",
-            "Projects"
+            "Projects",
+            "Json",
+            "ImageCore"
 		});
         PublicDependencyModuleNames.AddRange(
 	        new string[]
@@ -3,6 +3,7 @@
 #include "CoreMinimal.h"
 #include "Containers/Map.h"
 #include "Containers/StaticBitArray.h"
+#include "Containers/Ticker.h"
 #include "IAnselPlugin.h"
 #include "Camera/CameraTypes.h"
 #include "Camera/CameraPhotography.h"
@@ -19,19 +20,44 @@
 #include "Widgets/SWindow.h"
 #include "Application/SlateApplicationBase.h"
 #include "RenderResource.h"
+#include "DynamicRHI.h"
 #include "Interfaces/IPluginManager.h"
 #include "RenderUtils.h"
 #include "UnrealClient.h"
+#include "HighResScreenshot.h"
+#include "ImageUtils.h"
 #include "GameFramework/Pawn.h"
+#include "Async/Async.h"
+#include "Misc/CoreDelegates.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "UObject/StrongObjectPtr.h"
+#include "Misc/Paths.h"
+#include "Engine/Texture2D.h"
+#include <atomic>
 #include <functional>
 
 #include "AnselFunctionLibrary.h"
+#include "AnselUserControls.h"
+#include "AnselSessionEvents.h"
+#include "AnselUserControlRegistry.h"
+#include "AnselCameraConstraint.h"
+#include "AnselStats.h"
+#include "AnselTrace.h"
+#include "AnselMath.h"
+#include "AnselMemoryBudget.h"
+#include "AnselExposureProbe.h"
+#include "AnselGradingLUT.h"
+#include "AnselImage.h"
+#include "AnselAccumulation.h"
+#include "AnselBatchCapture.h"
 #include <AnselSDK.h>
 
 #include "Camera/CameraComponent.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogAnsel, Log, All);
 
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Camera Fast Path Frames"), STAT_AnselCameraFastPathFrames, STATGROUP_Ansel);
+
 #define LOCTEXT_NAMESPACE "Photography"
 
 static TAutoConsoleVariable<int32> CVarPhotographyAllow(
@@ -66,6 +92,16 @@ static TAutoConsoleVariable<float> CVarConstrainCameraDistance(
 	2500.0f,
 	TEXT("Maximum distance (in Unreal Units) which camera is allowed to wander from its initial position when constraining camera by distance.  Negative values disable default distance contraints. (Default: 2500.0)"));
 
+static TAutoConsoleVariable<int32> CVarConstrainCameraAsync(
+	TEXT("r.Photography.Constrain.Async"),
+	0,
+	TEXT("If 1, the default camera collision constraint sweeps asynchronously and applies each result one frame later, so the game thread never waits on physics.  The camera only moves into space already swept, by at most r.Photography.Constrain.AsyncMaxStep per frame. (Default: 0)"));
+
+static TAutoConsoleVariable<float> CVarConstrainCameraAsyncMaxStep(
+	TEXT("r.Photography.Constrain.AsyncMaxStep"),
+	50.0f,
+	TEXT("Maximum distance (in Unreal Units) which the camera may move per frame when r.Photography.Constrain.Async is enabled. (Default: 50.0)"));
+
 static TAutoConsoleVariable<int32> CVarPhotographyAutoPostprocess(
 	TEXT("r.Photography.AutoPostprocess"),
 	1,
@@ -82,6 +118,21 @@ static TAutoConsoleVariable<int32> CVarAllowHighQuality(
 	TEXT("Whether to permit Ansel RT (high-quality mode).\n"),
 	ECVF_RenderThreadSafe);
 
+static TAutoConsoleVariable<int32> CVarPhotographyMemoryHeadroom(
+	TEXT("r.Photography.MemoryHeadroomMB"),
+	1024,
+	TEXT("Memory (in MB) of both RAM and video memory which photography leaves free when sizing the 'extreme' streaming pool and deciding whether a batch capture fits.  (Default: 1024)"));
+
+static TAutoConsoleVariable<int32> CVarPhotographyLockExposure(
+	TEXT("r.Photography.LockExposure"),
+	1,
+	TEXT("If 1, multi-part captures use the exposure the whole frame had adapted to just before the capture for every tile, rather than letting each tile adapt to what it sees.  (Default: 1)"));
+
+static TAutoConsoleVariable<FString> CVarPhotographyGradingLUT(
+	TEXT("r.Photography.GradingLUT"),
+	TEXT(""),
+	TEXT("Path of a .cube 3D LUT with which to colour grade captured photographs, or empty for none.  Batch shots are graded through the full table as they're read back; Ansel captures get it resampled to 16x16x16 and applied after the scene's own colour grading LUT by the tonemapper, so it costs nothing extra per tile."));
+
 // intentionally undocumented
 static TAutoConsoleVariable<int32> CVarExtreme(
 	TEXT("r.Photography.Extreme"),
@@ -95,7 +146,7 @@ static TAutoConsoleVariable<int32> CVarExtreme(
 class FNVAnselCameraPhotographyPrivate : public ICameraPhotography
 {
 public:
-	FNVAnselCameraPhotographyPrivate();
+	FNVAnselCameraPhotographyPrivate(FAnselSessionEvents& InSessionEvents);
 	virtual ~FNVAnselCameraPhotographyPrivate() override;
 	virtual bool UpdateCamera(FMinimalViewInfo& InOutPOV, APlayerCameraManager* PCMgr) override;
 	virtual void UpdatePostProcessing(FPostProcessSettings& InOutPostProcessSettings) override;
@@ -106,30 +157,28 @@ public:
 	virtual void DefaultConstrainCamera(const FVector NewCameraLocation, const FVector PreviousCameraLocation, const FVector OriginalCameraLocation, FVector& OutCameraLocation, APlayerCameraManager* PCMgr) override;
 	virtual const TCHAR* const GetProviderName() override { return TEXT("NVIDIA Ansel"); };
 
-	enum econtrols {
-		control_dofscale,
-		control_dofsensorwidth,
-		control_doffocalregion,
-		control_doffocaldistance,
-		control_dofdepthbluramount,
-		control_dofdepthblurradius,
-		control_bloomintensity,
-		control_bloomscale,
-		control_scenefringeintensity,
-		control_OLDSettings,
-		control_LumenSettings,
-		control_SkylightSettings,
-		control_AntiAliasing,
-		control_sgQuality,
-		control_COUNT
-	};
-	typedef union {
-		bool bool_val;
-		float float_val;
-	} ansel_control_val;
+	/** Replaces the session camera with the given view from the next frame, bypassing camera constraints; for scripted captures */
+	void SetSessionViewOverride(const FMinimalViewInfo& View, bool bHighQuality);
+
+	/**
+	 * Lets the paused world tick NumSteps more times, one tick per frame, for stepping through a sequence
+	 * offline.  Returns false if the session isn't the one pausing the world.
+	 */
+	bool StepPausedWorld(int32 NumSteps);
+	bool IsSteppingPausedWorld() const { return PendingWorldSteps > 0; }
+
+	/** The r.Photography.GradingLUT table, or null if there's none or it couldn't be loaded */
+	TSharedPtr<const FAnselGradingLUT> GetGradingLUT();
+
+	/** Whether high resolution screenshots are being graded as they're read back, so the tonemapper shouldn't grade them too */
+	void SetGradingOnReadback(bool bInGradingOnReadback) { bGradingOnReadback = bInGradingOnReadback; }
+
+	/** Hooks the provider up to the SDK, once; on the game thread after the SDK's DLL has loaded */
+	void InitializeAnsel();
 
 private:
 	void ReconfigureAnsel();
+	void FlushPendingReconfigure();
 	void DeconfigureAnsel();
 
 	static ansel::StartSessionStatus AnselStartSessionCallback(ansel::SessionConfiguration& settings, void* userPointer);
@@ -138,26 +187,35 @@ private:
 	static void AnselStopCaptureCallback(void* userPointer);
 	static void AnselChangeQualityCallback(bool isHighQuality, void* userPointer);
 
-	static bool AnselCamerasMatch(ansel::Camera& a, ansel::Camera& b);
+	void OnViewportResized(FViewport* Viewport, uint32 Unused);
+	void OnPostWorldInitialization(UWorld* World, const UWorld::InitializationValues IVS);
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent);
+#endif
+	void RefreshViewConstraints(const FMinimalViewInfo& POV, APlayerCameraManager* PCMgr);
 
 	void AnselCameraToFMinimalView(FMinimalViewInfo& InOutPOV, ansel::Camera& AnselCam);
 	void FMinimalViewToAnselCamera(ansel::Camera& InOutAnselCam, FMinimalViewInfo& POV,float FOV);
+	FVector AnselPositionToWorld(const nv::Vec3& AnselPosition) const;
+	nv::Vec3 WorldToAnselPosition(const FVector& WorldPosition) const;
+	void RebaseAnselCameraOrigin();
 
 	bool BlueprintModifyCamera(ansel::Camera& InOutAnselCam, APlayerCameraManager* PCMgr); // returns whether modified cam is in original (session-start) position
 
 	void ConfigureRenderingSettingsForPhotography(FPostProcessSettings& InOutPostProcessSettings);
 	void SetUpSessionCVars();
+	void RegisterBuiltInUserControls();
+	void UnregisterBuiltInUserControls();
 	void DoCustomUIControls(FPostProcessSettings& InOutPPSettings, bool bRebuildControls);
-	void DeclareSlider(int id, FText LocTextLabel, float LowerBound, float UpperBound, float Val);
-	void DeclareBool(int id,FText LocTextLabel,bool Val);
-	bool ProcessUISlider(int id, float& InOutVal);
-	void ProcessUIBool(int id,bool& InOutVal);
+	bool ArePhotographySettingsApplied() const;
+	EAnselCaptureType GetCaptureType() const;
 	
 	bool CaptureCVar(FString CVarName);
 	void SetCapturedCVarPredicated(const char* CVarName, float valueIfNotReset, std::function<bool(const float, const float)> comparison, bool wantReset, bool useExistingPriority);
 	void SetCapturedCVar(const char* CVarName, float valueIfNotReset, bool wantReset = false, bool useExistingPriority = false);
 
-	ansel::Configuration* AnselConfig;
+	ansel::Configuration* AnselConfig = nullptr;
+	bool bAnselInitialized = false;
 	ansel::Camera AnselCamera;
 	ansel::Camera AnselCameraOriginal;
 	ansel::Camera AnselCameraPrevious;
@@ -165,6 +223,49 @@ private:
 	FMinimalViewInfo UECameraOriginal;
 	FMinimalViewInfo UECameraPrevious;
 
+	// The SDK only deals in floats, which can't place a camera precisely in a large world, so it's
+	// handed positions relative to this session-local origin instead.
+	FVector AnselCameraOrigin = FVector::ZeroVector;
+	FVector AnselCameraPreviousOrigin = FVector::ZeroVector; // what AnselCameraPrevious is relative to
+
+	FAnselCameraGeometryConstraint GeometryConstraint;
+
+	// exposure of the last whole frame before a multi-part capture, applied to every part of it
+	TSharedPtr<FAnselExposureProbe, ESPMode::ThreadSafe> ExposureProbe;
+	float LockedCaptureExposure = 0.f;
+
+	// r.Photography.GradingLUT as last loaded, null if that file couldn't be used, and its resampling for
+	// the tonemapper on top of the scene's own LUT, remade whenever that changes
+	FString GradingLUTFilename;
+	TSharedPtr<FAnselGradingLUT> GradingLUT;
+	TStrongObjectPtr<UTexture2D> GradingLUTTexture;
+	TWeakObjectPtr<UTexture> GradingLUTTextureBase;
+	float GradingLUTTextureBaseIntensity = 0.f;
+	bool bGradingLUTTextureStale = true;
+	bool bGradingOnReadback = false;
+	void RefreshGradingLUT();
+	void ApplyGradingLUT(FPostProcessSettings& InOutPostProcessingSettings);
+
+	// the view last derived from AnselCamera, reused for as long as the Ansel camera doesn't change
+	struct FAnselViewCache
+	{
+		float FOV;
+		FVector Location;
+		FRotator Rotation;
+		FVector2D OffCenterProjectionOffset;
+	} AnselViewCache;
+	uint32 NumCameraFastPathFrames = 0;
+
+	FAnselSessionEvents& SessionEvents;
+	FAnselSessionFrame SessionFrame;
+
+	FMinimalViewInfo SessionViewOverride;
+	bool bSessionViewOverridePending = false;
+	bool bPhotographySettingsChanged = false;
+
+	int32 PendingWorldSteps = 0;
+	bool bWorldStepInProgress = false;
+
 	FPostProcessSettings UEPostProcessingOriginal;
 
 	bool bAnselSessionActive;
@@ -209,10 +310,20 @@ private:
 	bool bHighSgQualityIsSetup = false;
 	
 	ansel::FovType RequiredFovType = ansel::kHorizontalFov;
-	ansel::FovType CurrentlyConfiguredFovType = ansel::kHorizontalFov;
 
 	float RequiredWorldToMeters = 100.f;
-	float CurrentlyConfiguredWorldToMeters = 0.f;
+
+	// the inputs to RequiredFovType and RequiredWorldToMeters change very rarely, so rather than
+	// walking PlayerController->LocalPlayer->Viewport every frame we only re-derive them after
+	// a viewport resize, world initialization or settings change has been signalled
+	bool bViewConstraintsDirty = true;
+	TWeakObjectPtr<APlayerCameraManager> ViewConstraintsCameraManager;
+	ECameraProjectionMode::Type ViewConstraintsProjectionMode = ECameraProjectionMode::Perspective;
+	FDelegateHandle ViewportResizedHandle;
+	FDelegateHandle PostWorldInitializationHandle;
+#if WITH_EDITOR
+	FDelegateHandle ObjectPropertyChangedHandle;
+#endif
 
 	uint32_t NumFramesSinceSessionStart;
 
@@ -220,15 +331,17 @@ private:
 	TStaticBitArray<256> bEffectUIAllowed;
 
 	bool bUIControlsNeedRebuild;
-	ansel::UserControlDesc UIControls[control_COUNT];
-	static ansel_control_val UIControlValues[control_COUNT]; // static to allow access from a callback
-	float UIControlRangeLower[control_COUNT];
-	float UIControlRangeUpper[control_COUNT];
 
 	/** Console variable delegate for checking when the console variables have changed */
 	FConsoleCommandDelegate CVarDelegate;
 	FConsoleVariableSinkHandle CVarDelegateHandle;
 
+	// Configuration changes are only noted by the CVar sink and other change notifications, then
+	// coalesced and applied at most once per frame from UpdateCamera; the sink can run many
+	// times per second when Blueprints drive the photography CVars every tick.
+	bool bReconfigurePending = false;
+	bool bAnselConfigured = false;
+
 	struct CVarInfo {
 		IConsoleVariable* cvar;
 		float fInitialVal;
@@ -237,10 +350,8 @@ private:
 	UCameraComponent* CameraComponent=nullptr;
 };
 
-FNVAnselCameraPhotographyPrivate::ansel_control_val FNVAnselCameraPhotographyPrivate::UIControlValues[control_COUNT];
-
 static void* AnselSDKDLLHandle = 0;
-static bool bAnselDLLLoaded = false;
+static std::atomic<bool> bAnselDLLLoaded(false); // set from the SDK loading task, see FAnselModule::StartupModule
 
 bool FNVAnselCameraPhotographyPrivate::CaptureCVar(FString CVarName)
 {
@@ -255,8 +366,9 @@ bool FNVAnselCameraPhotographyPrivate::CaptureCVar(FString CVarName)
 	return true;
 }
 
-FNVAnselCameraPhotographyPrivate::FNVAnselCameraPhotographyPrivate()
+FNVAnselCameraPhotographyPrivate::FNVAnselCameraPhotographyPrivate(FAnselSessionEvents& InSessionEvents)
 	: ICameraPhotography()
+	, SessionEvents(InSessionEvents)
 	, bAnselSessionActive(false)
 	, bAnselSessionNewlyActive(false)
 	, bAnselSessionWantDeactivate(false)
@@ -271,41 +383,57 @@ FNVAnselCameraPhotographyPrivate::FNVAnselCameraPhotographyPrivate()
 		bEffectUIAllowed[i] = true; // allow until explicitly disallowed
 	}
 
-	if (bAnselDLLLoaded)
+	// the SDK itself is hooked up by InitializeAnsel() once the module's loading task has finished
+}
+
+void FNVAnselCameraPhotographyPrivate::InitializeAnsel()
+{
+	check(IsInGameThread() && bAnselDLLLoaded);
+	if (bAnselInitialized)
 	{
-		AnselConfig = new ansel::Configuration();
+		return;
+	}
+	TRACE_CPUPROFILER_EVENT_SCOPE(FNVAnselCameraPhotographyPrivate::InitializeAnsel);
+	LLM_SCOPE_BYTAG(Ansel);
 
-		CVarDelegate = FConsoleCommandDelegate::CreateLambda([this] {
-			static float LastTranslationSpeed = -1.0f;
-			static int32 LastSettleFrames = -1;
-			
-			float ThisTranslationSpeed = CVarPhotographyTranslationSpeed->GetFloat();
-			int32 ThisSettleFrames = CVarPhotographySettleFrames->GetInt();
+	AnselConfig = new ansel::Configuration();
 
-			if (ThisTranslationSpeed != LastTranslationSpeed ||
-				ThisSettleFrames != LastSettleFrames)
-			{
-				ReconfigureAnsel();
-				LastTranslationSpeed = ThisTranslationSpeed;
-				LastSettleFrames = ThisSettleFrames;
-			}
-		});
+	CVarDelegate = FConsoleCommandDelegate::CreateLambda([this] {
+		// just note the change here; the SDK is reconfigured later, outside of the sink
+		if (AnselConfig->translationalSpeedInWorldUnitsPerSecond != CVarPhotographyTranslationSpeed->GetFloat() ||
+			AnselConfig->captureSettleLatency != uint32(CVarPhotographySettleFrames->GetInt()))
+		{
+			bReconfigurePending = true;
+		}
+	});
 
-		CVarDelegateHandle = IConsoleManager::Get().RegisterConsoleVariableSink_Handle(CVarDelegate);
-		ReconfigureAnsel();
-	}
-	else
-	{
-		UE_LOG(LogAnsel, Log, TEXT("Ansel DLL was not successfully loaded."));
-	}
+	CVarDelegateHandle = IConsoleManager::Get().RegisterConsoleVariableSink_Handle(CVarDelegate);
+
+	ViewportResizedHandle = FViewport::ViewportResizedEvent.AddRaw(this, &FNVAnselCameraPhotographyPrivate::OnViewportResized);
+	PostWorldInitializationHandle = FWorldDelegates::OnPostWorldInitialization.AddRaw(this, &FNVAnselCameraPhotographyPrivate::OnPostWorldInitialization);
+#if WITH_EDITOR
+	ObjectPropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddRaw(this, &FNVAnselCameraPhotographyPrivate::OnObjectPropertyChanged);
+#endif
+	ReconfigureAnsel();
+
+	RegisterBuiltInUserControls();
+	FAnselUserControlRegistry::Get().LoadFromConfig(GGameIni);
+
+	bAnselInitialized = true;
 }
 
 
 FNVAnselCameraPhotographyPrivate::~FNVAnselCameraPhotographyPrivate()
 {	
-	if (bAnselDLLLoaded)
+	if (bAnselInitialized)
 	{
 		IConsoleManager::Get().UnregisterConsoleVariableSink_Handle(CVarDelegateHandle);
+		FViewport::ViewportResizedEvent.Remove(ViewportResizedHandle);
+		FWorldDelegates::OnPostWorldInitialization.Remove(PostWorldInitializationHandle);
+#if WITH_EDITOR
+		FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(ObjectPropertyChangedHandle);
+#endif
+		UnregisterBuiltInUserControls();
 		DeconfigureAnsel();
 		delete AnselConfig;
 	}
@@ -314,7 +442,13 @@ FNVAnselCameraPhotographyPrivate::~FNVAnselCameraPhotographyPrivate()
 
 bool FNVAnselCameraPhotographyPrivate::IsSupported()
 {
-	return bAnselDLLLoaded && ansel::isAnselAvailable();
+	// 'not yet available' until the module has initialized the provider after the SDK's DLL loaded
+	if (!bAnselInitialized)
+	{
+		return false;
+	}
+	ANSEL_TRACE_SCOPE(AnselSDK_isAnselAvailable);
+	return ansel::isAnselAvailable();
 }
 
 void FNVAnselCameraPhotographyPrivate::SetUIControlVisibility(uint8 UIControlTarget, bool bIsVisible)
@@ -322,41 +456,133 @@ void FNVAnselCameraPhotographyPrivate::SetUIControlVisibility(uint8 UIControlTar
 	bEffectUIAllowed[UIControlTarget] = bIsVisible;
 }
 
-bool FNVAnselCameraPhotographyPrivate::AnselCamerasMatch(ansel::Camera& a, ansel::Camera& b)
+void FNVAnselCameraPhotographyPrivate::OnViewportResized(FViewport* Viewport, uint32 Unused)
+{
+	bViewConstraintsDirty = true;
+}
+
+void FNVAnselCameraPhotographyPrivate::OnPostWorldInitialization(UWorld* World, const UWorld::InitializationValues IVS)
 {
-	return a.position.x == b.position.x &&
-		a.position.y == b.position.y &&
-		a.position.z == b.position.z &&
-		a.rotation.x == b.rotation.x &&
-		a.rotation.y == b.rotation.y &&
-		a.rotation.z == b.rotation.z &&
-		a.rotation.w == b.rotation.w &&
-		a.fov == b.fov &&
-		a.projectionOffsetX == b.projectionOffsetX &&
-		a.projectionOffsetY == b.projectionOffsetY;
+	bViewConstraintsDirty = true;
+}
+
+#if WITH_EDITOR
+void FNVAnselCameraPhotographyPrivate::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	// WorldToMeters and AspectRatioAxisConstraint can be tweaked live in the editor
+	if (Object && (Object->IsA<AWorldSettings>() || Object->IsA<ULocalPlayer>()))
+	{
+		bViewConstraintsDirty = true;
+	}
+}
+#endif
+
+static void* GetGameWindowHandle()
+{
+	if (GEngine->GameViewport && GEngine->GameViewport->GetWindow().IsValid() && GEngine->GameViewport->GetWindow()->GetNativeWindow().IsValid())
+	{
+		return GEngine->GameViewport->GetWindow()->GetNativeWindow()->GetOSWindowHandle();
+	}
+	return nullptr;
+}
+
+void FNVAnselCameraPhotographyPrivate::RefreshViewConstraints(const FMinimalViewInfo& POV, APlayerCameraManager* PCMgr)
+{
+	const ansel::FovType PreviousFovType = RequiredFovType;
+	const float PreviousWorldToMeters = RequiredWorldToMeters;
+
+	// 1. detect world-to-meters scale
+	if (const UWorld* World = PCMgr->GetWorld())
+	{
+		const AWorldSettings* WorldSettings = World->GetWorldSettings();
+		if (WorldSettings && WorldSettings->WorldToMeters != 0.f)
+		{
+			RequiredWorldToMeters = WorldSettings->WorldToMeters;
+		}
+	}
+	// 2. detect FOV constraint settings - vital for multi-part snapshot tiling
+	if (const APlayerController* PC = PCMgr->GetOwningPlayerController())
+	{
+		if (const ULocalPlayer* LocalPlayer = PC->GetLocalPlayer())
+		{
+			if (const UGameViewportClient* ViewportClient = LocalPlayer->ViewportClient)
+			{
+				if (const FViewport* Viewport = ViewportClient->Viewport)
+				{
+					const FVector2D& LPViewScale = LocalPlayer->Size;
+					uint32 SizeX = FMath::TruncToInt(LPViewScale.X * Viewport->GetSizeXY().X);
+					uint32 SizeY = FMath::TruncToInt(LPViewScale.Y * Viewport->GetSizeXY().Y);
+
+					EAspectRatioAxisConstraint AspectRatioAxisConstraint = LocalPlayer->AspectRatioAxisConstraint;
+
+					// (logic from FMinimalViewInfo::CalculateProjectionMatrixGivenView() -) if x is bigger, and we're respecting x or major axis, AND mobile isn't forcing us to be Y axis aligned
+					if (((SizeX > SizeY) && (AspectRatioAxisConstraint == AspectRatio_MajorAxisFOV)) || (AspectRatioAxisConstraint == AspectRatio_MaintainXFOV) || (POV.ProjectionMode == ECameraProjectionMode::Orthographic))
+					{
+						RequiredFovType = ansel::kHorizontalFov;
+					}
+					else
+					{
+						RequiredFovType = ansel::kVerticalFov;
+					}
+				}
+			}
+		}
+	}
+
+	ViewConstraintsCameraManager = PCMgr;
+	ViewConstraintsProjectionMode = POV.ProjectionMode;
+	bViewConstraintsDirty = false;
+
+	// the game window may also have changed by now
+	void* const GameWindowHandle = GetGameWindowHandle();
+	if (RequiredFovType != PreviousFovType || RequiredWorldToMeters != PreviousWorldToMeters ||
+		(GameWindowHandle && AnselConfig && GameWindowHandle != AnselConfig->gameWindowHandle) || !bAnselConfigured)
+	{
+		bReconfigurePending = true;
+	}
 }
 
 void FNVAnselCameraPhotographyPrivate::AnselCameraToFMinimalView(FMinimalViewInfo& InOutPOV, ansel::Camera& AnselCam)
 {
 	InOutPOV.FOV = AnselCam.fov;
-	InOutPOV.Location.X = AnselCam.position.x;
-	InOutPOV.Location.Y = AnselCam.position.y;
-	InOutPOV.Location.Z = AnselCam.position.z;
-	FQuat rotq(AnselCam.rotation.x, AnselCam.rotation.y, AnselCam.rotation.z, AnselCam.rotation.w);
-	InOutPOV.Rotation = FRotator(rotq);
+	InOutPOV.Location = AnselPositionToWorld(AnselCam.position);
+	InOutPOV.Rotation = AnselMath::RotationToWorld(AnselCam.rotation);
 	InOutPOV.OffCenterProjectionOffset.Set(AnselCam.projectionOffsetX, AnselCam.projectionOffsetY);
 }
 
 void FNVAnselCameraPhotographyPrivate::FMinimalViewToAnselCamera(ansel::Camera& InOutAnselCam, FMinimalViewInfo& POV,float FOV)
 {
 	InOutAnselCam.fov = FOV;
-	InOutAnselCam.position = { float(POV.Location.X), float(POV.Location.Y), float(POV.Location.Z) };
-	FQuat rotq = POV.Rotation.Quaternion();
-	InOutAnselCam.rotation = { float(rotq.X),float(rotq.Y),float(rotq.Z),float(rotq.W) };
+	InOutAnselCam.position = WorldToAnselPosition(POV.Location);
+	InOutAnselCam.rotation = AnselMath::WorldToRotation(POV.Rotation);
 	InOutAnselCam.projectionOffsetX = 0.f; // Ansel only writes these, doesn't read
 	InOutAnselCam.projectionOffsetY = 0.f;
 }
 
+FVector FNVAnselCameraPhotographyPrivate::AnselPositionToWorld(const nv::Vec3& AnselPosition) const
+{
+	return AnselMath::PositionToWorld(AnselPosition, AnselCameraOrigin);
+}
+
+nv::Vec3 FNVAnselCameraPhotographyPrivate::WorldToAnselPosition(const FVector& WorldPosition) const
+{
+	return AnselMath::WorldToPosition(WorldPosition, AnselCameraOrigin);
+}
+
+void FNVAnselCameraPhotographyPrivate::RebaseAnselCameraOrigin()
+{
+	// keep the camera-relative position small enough for floats to resolve well under a millimetre;
+	// never mid-capture, as the SDK derives every tile from the camera at capture start
+	static const float MaxAnselCameraOffset = 65536.f;
+
+	if (bAnselCaptureActive)
+	{
+		return;
+	}
+
+	AnselMath::RebaseOrigin(AnselCamera.position, AnselCameraOrigin, MaxAnselCameraOffset);
+}
+
 bool FNVAnselCameraPhotographyPrivate::BlueprintModifyCamera(ansel::Camera& InOutAnselCam, APlayerCameraManager* PCMgr)
 {
 	FMinimalViewInfo Proposed;
@@ -364,9 +590,7 @@ bool FNVAnselCameraPhotographyPrivate::BlueprintModifyCamera(ansel::Camera& InOu
 	AnselCameraToFMinimalView(Proposed, InOutAnselCam);
 	PCMgr->PhotographyCameraModify(Proposed.Location, UECameraPrevious.Location, UECameraOriginal.Location, Proposed.Location/*out by ref*/);
 	// only position has possibly changed
-	InOutAnselCam.position.x = Proposed.Location.X;
-	InOutAnselCam.position.y = Proposed.Location.Y;
-	InOutAnselCam.position.z = Proposed.Location.Z;
+	InOutAnselCam.position = WorldToAnselPosition(Proposed.Location);
 
 	UECameraPrevious = Proposed;
 
@@ -377,207 +601,164 @@ bool FNVAnselCameraPhotographyPrivate::BlueprintModifyCamera(ansel::Camera& InOu
 	return bIsCameraInOriginalTransform;
 }
 
-void FNVAnselCameraPhotographyPrivate::DeclareSlider(int id, FText LocTextLabel, float LowerBound, float UpperBound, float Val)
+// built-in controls; games can add more through IAnselModule::RegisterUserControl or Game.ini
+static const FName BuiltInUserControlNames[] =
 {
-	UIControlRangeLower[id] = LowerBound;
-	UIControlRangeUpper[id] = UpperBound;
-
-	UIControls[id].labelUtf8 = TCHAR_TO_UTF8(LocTextLabel.ToString().GetCharArray().GetData());
-	UIControlValues[id].float_val = FMath::GetRangePct(LowerBound, UpperBound, Val);
-
-	UIControls[id].callback = [](const ansel::UserControlInfo& info) {
-		UIControlValues[info.userControlId - 1].float_val = *(float*)info.value;
-	};
-	UIControls[id].info.userControlId = id + 1; // reserve 0 as 'unused'
-	UIControls[id].info.userControlType = ansel::kUserControlSlider;
-	UIControls[id].info.value = &UIControlValues[id].float_val;
+	TEXT("Ansel.LODHigh"),
+	TEXT("Ansel.LumenHigh"),
+	TEXT("Ansel.SkylightHigh"),
+	TEXT("Ansel.AntiAliasingHigh"),
+	TEXT("Ansel.SgQualityHigh"),
+	TEXT("Ansel.DofSensorWidth"),
+	TEXT("Ansel.DofFocalDistance"),
+	TEXT("Ansel.DofDepthBlurAmount"),
+	TEXT("Ansel.DofDepthBlurRadius"),
+	TEXT("Ansel.BloomIntensity"),
+	TEXT("Ansel.BloomScale"),
+	TEXT("Ansel.ChromaticAberration"),
+};
 
-	ansel::UserControlStatus status = ansel::addUserControl(UIControls[id]);
-	UE_LOG(LogAnsel, Log, TEXT("control#%d status=%d"), (int)id, (int)status);
-}
-//声明bool值
-void FNVAnselCameraPhotographyPrivate::DeclareBool(int id,FText LocTextLabel,bool Val)
+void FNVAnselCameraPhotographyPrivate::RegisterBuiltInUserControls()
 {
-	UIControls[id].labelUtf8 = TCHAR_TO_UTF8(LocTextLabel.ToString().GetCharArray().GetData());
-	UIControlValues[id].bool_val = Val;
-	UIControls[id].callback = [](const ansel::UserControlInfo& info)
+	FAnselUserControlRegistry& Registry = FAnselUserControlRegistry::Get();
+	int32 NameIndex = 0;
+
+	//声明bool值
+	auto DeclareBool = [&Registry, &NameIndex](FText LocTextLabel, bool& DesiredFlag)
 	{
-		UIControlValues[info.userControlId - 1].bool_val = *(bool*)info.value;
+		FAnselUserControlDesc Desc;
+		Desc.Name = BuiltInUserControlNames[NameIndex++];
+		Desc.Label = LocTextLabel;
+		Desc.Type = EAnselUserControlType::Bool;
+		Desc.Target = EAnselUserControlTarget::Callback;
+		Desc.OnValueChanged = [&DesiredFlag](float Val) { DesiredFlag = Val != 0.f; }; // 这里已经将值传输到对应位置了
+		Registry.Register(Desc);
 	};
-	UIControls[id].info.userControlId = id+1;
-	UIControls[id].info.userControlType = ansel::kUserControlBoolean;
-	UIControls[id].info.value = &UIControlValues[id].bool_val;
-	ansel::UserControlStatus status = ansel::addUserControl(UIControls[id]);
-}
+	DeclareBool(LOCTEXT("LOD_Settings","LOD High"), bHighLodDesired);
+	DeclareBool(LOCTEXT("Lumen_Settings","Lumen High"), bHighLumenDesired);
+	DeclareBool(LOCTEXT("Skylight_Settings","Skylight High"), bHighSkyLightDesired);
+	DeclareBool(LOCTEXT("AntiAliasing_Settings","AntiAliasing High"), bHighAntiAliasingDesired);
+	DeclareBool(LOCTEXT("sgQuality_Settings","SQ_Quality High"), bHighSgQualityDesired);
 
-bool FNVAnselCameraPhotographyPrivate::ProcessUISlider(int id, float& InOutVal)
-{
-	if (UIControls[id].info.userControlId <= 0)
+	auto DeclareSlider = [&Registry, &NameIndex](FText LocTextLabel, FName PostProcessMember, float LowerBound, float UpperBound, EUIControlEffectTarget EffectGroup, TArray<FName> RequiresActive)
 	{
-		return false; // control is not in use
-	}
+		FAnselUserControlDesc Desc;
+		Desc.Name = BuiltInUserControlNames[NameIndex++];
+		Desc.Label = LocTextLabel;
+		Desc.Type = EAnselUserControlType::Slider;
+		Desc.Target = EAnselUserControlTarget::PostProcess;
+		Desc.TargetName = PostProcessMember;
+		Desc.Min = LowerBound;
+		Desc.Max = UpperBound;
+		Desc.EffectGroup = EffectGroup;
+		Desc.RequiresActive = MoveTemp(RequiresActive);
+		Registry.Register(Desc);
+	};
 
-	InOutVal = FMath::Lerp(UIControlRangeLower[id], UIControlRangeUpper[id], UIControlValues[id].float_val);
-	return true;
+	const TArray<FName> DofActive = { TEXT("DepthOfFieldFstop"), TEXT("DepthOfFieldFocalDistance") };
+	DeclareSlider(
+		LOCTEXT("control_dofsensorwidth", "Focus Sensor"), // n.b. similar effect to focus scale
+		TEXT("DepthOfFieldSensorWidth"),
+		0.1f, 1000.f,
+		DepthOfField, DofActive
+	);
+	DeclareSlider(
+		LOCTEXT("control_doffocaldistance", "Focus Distance"),
+		TEXT("DepthOfFieldFocalDistance"),
+		0.f, 1000.f, // UU - doc'd to 10000U but that's too coarse for a narrow UI control
+		DepthOfField, DofActive
+	);
+	DeclareSlider(
+		LOCTEXT("control_dofbluramount", "Blur Distance km"),
+		TEXT("DepthOfFieldDepthBlurAmount"),
+		0.000001f, 1.f, // km; doc'd as up to 100km but that's too coarse for a narrow UI control
+		DepthOfField, DofActive
+	);
+	DeclareSlider(
+		LOCTEXT("control_dofblurradius", "Blur Radius"),
+		TEXT("DepthOfFieldDepthBlurRadius"),
+		0.f, 4.f,
+		DepthOfField, DofActive
+	);
+	DeclareSlider(
+		LOCTEXT("control_bloomintensity", "Bloom Intensity"),
+		TEXT("BloomIntensity"),
+		0.f, 8.f,
+		Bloom, { TEXT("BloomIntensity") }
+	);
+	DeclareSlider(
+		LOCTEXT("control_bloomscale", "Bloom Scale"),
+		TEXT("BloomSizeScale"),
+		0.f, 64.f,
+		Bloom, { TEXT("BloomIntensity") }
+	);
+	DeclareSlider(
+		LOCTEXT("control_chromaticaberration", "Chromatic Aberration"),
+		TEXT("SceneFringeIntensity"),
+		0.f, 15.f, // note: FPostProcesssSettings metadata says range is 0./5. but larger values have been seen in the wild 
+		ChromaticAberration, { TEXT("SceneFringeIntensity") }
+	);
+	check(NameIndex == UE_ARRAY_COUNT(BuiltInUserControlNames));
 }
 
-void FNVAnselCameraPhotographyPrivate::ProcessUIBool(int id, bool& InOutVal)
+void FNVAnselCameraPhotographyPrivate::UnregisterBuiltInUserControls()
 {
-	if (UIControls[id].info.userControlId <= 0)
+	FAnselUserControlRegistry& Registry = FAnselUserControlRegistry::Get();
+	Registry.RemoveAllFromOverlay();
+	for (const FName& Name : BuiltInUserControlNames)
 	{
-		InOutVal = false; // control is not in use
+		Registry.Unregister(Name);
 	}
-	InOutVal = UIControlValues[id].bool_val;
 }
 
 void FNVAnselCameraPhotographyPrivate::DoCustomUIControls(FPostProcessSettings& InOutPPSettings, bool bRebuildControls)
 {
+	ANSEL_TRACE_SCOPE(FNVAnselCameraPhotographyPrivate::DoCustomUIControls);
+	FAnselUserControlRegistry& Registry = FAnselUserControlRegistry::Get();
+	auto SetCVar = [this](const TCHAR* CVarName, float Value)
+	{
+		SetCapturedCVar(TCHAR_TO_ANSI(CVarName), Value); // restored at session end
+	};
+
 	if (bRebuildControls)
 	{
-		// clear existing controls
-		for (int i = 0; i < control_COUNT; ++i)
-		{
-			if (UIControls[i].info.userControlId > 0) // we are using id 0 as 'unused'
-			{
-				ansel::removeUserControl(UIControls[i].info.userControlId);
-				UIControls[i].info.userControlId = 0;
-			}
-		}
-		
-		DeclareBool(control_OLDSettings,LOCTEXT("LOD_Settings","LOD High"),false);
-		DeclareBool(control_LumenSettings,LOCTEXT("Lumen_Settings","Lumen High"),false);
-		DeclareBool(control_SkylightSettings,LOCTEXT("Skylight_Settings","Skylight High"),false);
-		DeclareBool(control_AntiAliasing,LOCTEXT("AntiAliasing_Settings","AntiAliasing High"),false);
-		DeclareBool(control_sgQuality,LOCTEXT("sgQuality_Settings","SQ_Quality High"),false);
 		// save postproc settings at session start
 		UEPostProcessingOriginal = InOutPPSettings;
 
-		// add all relevant controls
-		PRAGMA_DISABLE_DEPRECATION_WARNINGS
-		if (bEffectUIAllowed[DepthOfField])
-		{
-			const bool bAnyDofVisible = InOutPPSettings.DepthOfFieldFstop > 0 && InOutPPSettings.DepthOfFieldFocalDistance > 0;
-
-			if (bAnyDofVisible)
-			{
-				DeclareSlider(
-					control_dofsensorwidth,
-					LOCTEXT("control_dofsensorwidth", "Focus Sensor"), // n.b. similar effect to focus scale
-					0.1f, 1000.f,
-					InOutPPSettings.DepthOfFieldSensorWidth
-				);
-
-				DeclareSlider(
-					control_doffocaldistance,
-					LOCTEXT("control_doffocaldistance", "Focus Distance"),
-					0.f, 1000.f, // UU - doc'd to 10000U but that's too coarse for a narrow UI control
-					InOutPPSettings.DepthOfFieldFocalDistance
-				);
-
-				DeclareSlider(
-					control_dofdepthbluramount,
-					LOCTEXT("control_dofbluramount", "Blur Distance km"),
-					0.000001f, 1.f, // km; doc'd as up to 100km but that's too coarse for a narrow UI control
-					InOutPPSettings.DepthOfFieldDepthBlurAmount
-				);
-
-				DeclareSlider(
-					control_dofdepthblurradius,
-					LOCTEXT("control_dofblurradius", "Blur Radius"),
-					0.f, 4.f,
-					InOutPPSettings.DepthOfFieldDepthBlurRadius
-				);
-			}
-		}
-		PRAGMA_ENABLE_DEPRECATION_WARNINGS
-
-		if (bEffectUIAllowed[Bloom] &&
-			InOutPPSettings.BloomIntensity > 0.f)
-		{
-			DeclareSlider(
-				control_bloomintensity,
-				LOCTEXT("control_bloomintensity", "Bloom Intensity"),
-				0.f, 8.f,
-				InOutPPSettings.BloomIntensity
-			);
-			DeclareSlider(
-				control_bloomscale,
-				LOCTEXT("control_bloomscale", "Bloom Scale"),
-				0.f, 64.f,
-				InOutPPSettings.BloomSizeScale
-			);
-		}
-
-		if (bEffectUIAllowed[ChromaticAberration] &&
-			InOutPPSettings.SceneFringeIntensity > 0.f)
-		{
-			DeclareSlider(
-				control_scenefringeintensity,
-				LOCTEXT("control_chromaticaberration", "Chromatic Aberration"),
-				0.f, 15.f, // note: FPostProcesssSettings metadata says range is 0./5. but larger values have been seen in the wild 
-				InOutPPSettings.SceneFringeIntensity
-			);
-		}
+		// only the controls whose relevance changed since the last session are added or removed
+		Registry.SyncForSession(UEPostProcessingOriginal, bEffectUIAllowed, SetCVar);
 
 		bUIControlsNeedRebuild = false;
 	}
 
+	// fold in whatever the overlay has changed since last frame
+	if (Registry.ConsumeControlEvents(SetCVar))
+	{
+		bPhotographySettingsChanged = true;
+	}
+
 	// postprocessing is based upon postprocessing settings at session start time (avoids set of
 	// UI tweakables changing due to the camera wandering between postprocessing volumes, also
 	// avoids most discontinuities where stereo and panoramic captures can also wander between
-	// postprocessing volumes during the capture process)
+	// postprocessing volumes during the capture process).  The engine re-blends the incoming
+	// settings for every view so this restore can't be skipped, but only the controls actually in
+	// use are patched on top of it.
 	InOutPPSettings = UEPostProcessingOriginal;
 
-	// update values where corresponding controls are in use
-	if (ProcessUISlider(control_dofscale, InOutPPSettings.DepthOfFieldScale))
-	{
-		InOutPPSettings.bOverride_DepthOfFieldScale = 1;
-	}
-	if (ProcessUISlider(control_doffocalregion, InOutPPSettings.DepthOfFieldFocalRegion))
-	{
-		InOutPPSettings.bOverride_DepthOfFieldFocalRegion = 1;
-	}
-	if (ProcessUISlider(control_dofsensorwidth, InOutPPSettings.DepthOfFieldSensorWidth))
-	{
-		InOutPPSettings.bOverride_DepthOfFieldSensorWidth = 1;
-	}
-	if (ProcessUISlider(control_doffocaldistance, InOutPPSettings.DepthOfFieldFocalDistance))
-	{
-		InOutPPSettings.bOverride_DepthOfFieldFocalDistance = 1;
-	}
-	if (ProcessUISlider(control_dofdepthbluramount, InOutPPSettings.DepthOfFieldDepthBlurAmount))
-	{
-		InOutPPSettings.bOverride_DepthOfFieldDepthBlurAmount = 1;
-	}
-	if (ProcessUISlider(control_dofdepthblurradius, InOutPPSettings.DepthOfFieldDepthBlurRadius))
-	{
-		InOutPPSettings.bOverride_DepthOfFieldDepthBlurRadius = 1;
-	}
-	if (ProcessUISlider(control_bloomintensity, InOutPPSettings.BloomIntensity))
-	{
-		InOutPPSettings.bOverride_BloomIntensity = 1;
-	}
-	if (ProcessUISlider(control_bloomscale, InOutPPSettings.BloomSizeScale))
-	{
-		InOutPPSettings.bOverride_BloomSizeScale = 1;
-	}
-	if (ProcessUISlider(control_scenefringeintensity, InOutPPSettings.SceneFringeIntensity))
-	{
-		InOutPPSettings.bOverride_SceneFringeIntensity = 1;
-	}
-
-	// 这里已经将值传输到对应位置了
-	ProcessUIBool(control_OLDSettings,bHighLodDesired);
-	ProcessUIBool(control_LumenSettings,bHighLumenDesired);
-	ProcessUIBool(control_SkylightSettings,bHighSkyLightDesired);
-	ProcessUIBool(control_AntiAliasing,bHighAntiAliasingDesired);
-	ProcessUIBool(control_sgQuality,bHighSgQualityDesired);
+	Registry.ApplyPostProcessOverrides(InOutPPSettings);
 }
 
 bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV, APlayerCameraManager* PCMgr)
 {
+	ANSEL_TRACE_SCOPE(FNVAnselCameraPhotographyPrivate::UpdateCamera);
+	LLM_SCOPE_BYTAG(Ansel);
 	check(PCMgr != nullptr);
 	bool bGameCameraCutThisFrame = false;
+
+	if (!bAnselInitialized)
+	{
+		return bGameCameraCutThisFrame;
+	}
 	
 	bForceDisallow = false;
 	if (!bAnselSessionActive)
@@ -594,52 +775,18 @@ bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV,
 		// forbid photography if in stereoscopic/VR mode
 		bForceDisallow = bForceDisallow || (GEngine->IsStereoscopic3D());
 
-		// continually check for infrequent changes in some game parameters which annoyingly
-		// require Ansel to be completely reinitialized:
-		// 1. detect world-to-meters scale
-		if (const UWorld* World = GEngine->GetWorld())
+		// some infrequently-changing game parameters annoyingly require Ansel to be completely
+		// reinitialized; only re-derive them once we've been told their inputs may have changed
+		if (bViewConstraintsDirty ||
+			ViewConstraintsCameraManager != PCMgr ||
+			ViewConstraintsProjectionMode != InOutPOV.ProjectionMode)
 		{
-			const AWorldSettings* WorldSettings = World->GetWorldSettings();
-			if (WorldSettings && WorldSettings->WorldToMeters != 0.f)
-			{
-				RequiredWorldToMeters = WorldSettings->WorldToMeters;
-			}
-		}
-		// 2. detect FOV constraint settings - vital for multi-part snapshot tiling
-		if (const APlayerController* PC = PCMgr->GetOwningPlayerController())
-		{
-			if (const ULocalPlayer* LocalPlayer = PC->GetLocalPlayer())
-			{
-				if (const UGameViewportClient* ViewportClient = LocalPlayer->ViewportClient)
-				{
-					if (const FViewport* Viewport = ViewportClient->Viewport)
-					{
-						const FVector2D& LPViewScale = LocalPlayer->Size;
-						uint32 SizeX = FMath::TruncToInt(LPViewScale.X * Viewport->GetSizeXY().X);
-						uint32 SizeY = FMath::TruncToInt(LPViewScale.Y * Viewport->GetSizeXY().Y);
-
-						EAspectRatioAxisConstraint AspectRatioAxisConstraint = LocalPlayer->AspectRatioAxisConstraint;
-
-						// (logic from FMinimalViewInfo::CalculateProjectionMatrixGivenView() -) if x is bigger, and we're respecting x or major axis, AND mobile isn't forcing us to be Y axis aligned
-						if (((SizeX > SizeY) && (AspectRatioAxisConstraint == AspectRatio_MajorAxisFOV)) || (AspectRatioAxisConstraint == AspectRatio_MaintainXFOV) || (InOutPOV.ProjectionMode == ECameraProjectionMode::Orthographic))
-						{
-							RequiredFovType = ansel::kHorizontalFov;
-						}
-						else
-						{
-							RequiredFovType = ansel::kHorizontalFov;
-						}
-					}
-				}
-			}
-		}
-		if (CurrentlyConfiguredWorldToMeters != RequiredWorldToMeters ||
-			CurrentlyConfiguredFovType != RequiredFovType)
-		{
-			ReconfigureAnsel();
+			RefreshViewConstraints(InOutPOV, PCMgr);
 		}
 	}
 
+	FlushPendingReconfigure();
+
 	if (bAnselSessionActive)
 	{
 		APlayerController* PCOwner = PCMgr->GetOwningPlayerController();
@@ -655,8 +802,14 @@ bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV,
 			PCMgr->OnPhotographyMultiPartCaptureStart();
 			bGameCameraCutThisFrame = true;
 			bAnselCaptureNewlyActive = false;
+
+			// the probe still holds last frame's exposure, i.e. that of the whole frame before the first tile
+			LockedCaptureExposure = (CVarPhotographyLockExposure->GetInt() && ExposureProbe.IsValid()) ? ExposureProbe->GetLastExposure() : 0.f;
 			
-			
+			SessionFrame.FramesSinceCaptureStart = 0;
+			SessionEvents.bCaptureActive = true;
+			SessionEvents.OnCaptureStarted.Broadcast(GetCaptureType());
+			AnselTrace::CaptureStarted(GetCaptureType());
 		}
 
 		if (bAnselCaptureNewlyFinished)
@@ -664,6 +817,10 @@ bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV,
 			bGameCameraCutThisFrame = true;
 			bAnselCaptureNewlyFinished = false;
 			PCMgr->OnPhotographyMultiPartCaptureEnd();
+
+			SessionEvents.bCaptureActive = false;
+			SessionEvents.OnCaptureEnded.Broadcast(GetCaptureType());
+			AnselTrace::CaptureEnded(GetCaptureType());
 		}
 
 		if (bAnselSessionWantDeactivate)
@@ -721,15 +878,31 @@ bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV,
 			bHighQualityModeIsSetup = false;
 			PCMgr->OnPhotographySessionEnd(); // after unpausing
 
+			SessionEvents.bSessionActive = false;
+			SessionEvents.bCaptureActive = false;
+			SessionEvents.OnSessionEnded.Broadcast();
+			AnselTrace::SessionEnded();
+
+			UE_LOG(LogAnsel, Log, TEXT("Session ended: %u frames, %u with an unchanged camera"), NumFramesSinceSessionStart, NumCameraFastPathFrames);
+			if (GeometryConstraint.GetNumConstrainedFrames() > 0)
+			{
+				UE_LOG(LogAnsel, Log, TEXT("Camera constraint (%s): %d frames, %.1f us/frame on the game thread"),
+					CVarConstrainCameraAsync->GetInt() ? TEXT("async") : TEXT("sync"),
+					GeometryConstraint.GetNumConstrainedFrames(),
+					GeometryConstraint.GetConstrainSeconds() * 1000000.0 / GeometryConstraint.GetNumConstrainedFrames());
+			}
+
 			// no need to restore original camera params; re-clobbered every frame
 		}
 		else
 		{
-			bCameraIsInOriginalState = false;
+			bool bAnselCameraUnchanged = false;
 
 			if (bAnselSessionNewlyActive)
 			{
 				NumFramesSinceSessionStart = 0;
+				NumCameraFastPathFrames = 0;
+				SET_DWORD_STAT(STAT_AnselCameraFastPathFrames, 0);
 
 				PCMgr->OnPhotographySessionStart(); // before pausing
 
@@ -770,26 +943,67 @@ bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV,
 
 				bUIControlsNeedRebuild = true;
 
+				GeometryConstraint.Reset();
+				if (!ExposureProbe.IsValid())
+				{
+					ExposureProbe = FSceneViewExtensions::NewExtension<FAnselExposureProbe>();
+				}
+				PendingWorldSteps = 0;
+				bWorldStepInProgress = false;
+
 				// store initial camera info
 				UECameraPrevious = InOutPOV;
 				UECameraOriginal = InOutPOV;
 				
+				AnselCameraOrigin = InOutPOV.Location;
 				FMinimalViewToAnselCamera(AnselCamera, InOutPOV,PCMgr->GetFOVAngle());
-				ansel::updateCamera(AnselCamera);
+				{
+					ANSEL_TRACE_SCOPE(AnselSDK_updateCamera);
+					ansel::updateCamera(AnselCamera);
+				}
 
 				//AnselCameraOriginal = AnselCamera;
 				AnselCameraPrevious = AnselCamera;
+				AnselCameraPreviousOrigin = AnselCameraOrigin;
 
 				bCameraIsInOriginalState = true;
 
 				bAnselSessionNewlyActive = false;
+
+				SessionFrame = FAnselSessionFrame();
+				SessionEvents.bSessionActive = true;
+				SessionEvents.OnSessionStarted.Broadcast();
+				AnselTrace::SessionStarted();
 			}
 			else
 			{
-				ansel::updateCamera(AnselCamera);
+				const bool bSessionViewOverridden = bSessionViewOverridePending;
+				if (bSessionViewOverridePending)
+				{
+					// a scripted view replaces the camera outright, so it isn't constrained either
+					bSessionViewOverridePending = false;
+					AnselCameraOrigin = SessionViewOverride.Location;
+					FMinimalViewToAnselCamera(AnselCamera, SessionViewOverride, SessionViewOverride.FOV);
+					UECameraPrevious = SessionViewOverride;
+				}
+
+				{
+					ANSEL_TRACE_SCOPE(AnselSDK_updateCamera);
+					ansel::updateCamera(AnselCamera);
+				}
+
+				// if the user hasn't touched the camera, last frame's Blueprint modification, constraint
+				// and view all still stand; a scripted view puts the SDK camera back on its own origin, so it
+				// always takes the slow path, however much it looks like the last one
+				bAnselCameraUnchanged = !bSessionViewOverridden && !GeometryConstraint.IsStepPending() &&
+					AnselMath::ViewsMatch(AnselCamera, AnselCameraOrigin, AnselCameraPrevious, AnselCameraPreviousOrigin);
 
 				// active session; give Blueprints opportunity to modify camera, unless a capture is in progress
-				if (!bAnselCaptureActive)
+				if (bAnselCaptureActive)
+				{
+					bCameraIsInOriginalState = false;
+				}
+				else if (!bAnselCameraUnchanged && !bSessionViewOverridden)
 				{
 					bCameraIsInOriginalState = BlueprintModifyCamera(AnselCamera, PCMgr);
 				}
@@ -806,9 +1020,59 @@ bool FNVAnselCameraPhotographyPrivate::UpdateCamera(FMinimalViewInfo& InOutPOV,
 				}
 			}
 
-			AnselCameraToFMinimalView(InOutPOV, AnselCamera  );
+			// stepping: the world was unpaused for exactly this frame's tick, so pause it again, and unpause
+			// for next frame's tick if more steps are wanted
+			if (bWorldStepInProgress)
+			{
+				bWorldStepInProgress = false;
+				--PendingWorldSteps;
+				PCOwner->GetWorldSettings()->SetTimeDilation(0.f);
+				PCOwner->SetPause(true);
+			}
+			if (PendingWorldSteps > 0 && bPausedInternally && !bAnselCaptureActive)
+			{
+				bWorldStepInProgress = true;
+				PCOwner->GetWorldSettings()->SetTimeDilation(fTimeDilationBeforeSession);
+				PCOwner->SetPause(false);
+			}
+
+			if (bAnselCameraUnchanged)
+			{
+				++NumCameraFastPathFrames;
+				INC_DWORD_STAT(STAT_AnselCameraFastPathFrames);
+
+				InOutPOV.FOV = AnselViewCache.FOV;
+				InOutPOV.Location = AnselViewCache.Location;
+				InOutPOV.Rotation = AnselViewCache.Rotation;
+				InOutPOV.OffCenterProjectionOffset = AnselViewCache.OffCenterProjectionOffset;
+			}
+			else
+			{
+				AnselCameraToFMinimalView(InOutPOV, AnselCamera  );
 
-			AnselCameraPrevious = AnselCamera;
+				AnselViewCache.FOV = InOutPOV.FOV;
+				AnselViewCache.Location = InOutPOV.Location;
+				AnselViewCache.Rotation = InOutPOV.Rotation;
+				AnselViewCache.OffCenterProjectionOffset = InOutPOV.OffCenterProjectionOffset;
+
+				RebaseAnselCameraOrigin();
+				AnselCameraPrevious = AnselCamera;
+				AnselCameraPreviousOrigin = AnselCameraOrigin;
+			}
+
+			// let listeners follow the session along, e.g. to tell when the rendering has settled
+			const bool bViewSettled = bAnselCameraUnchanged && !bPhotographySettingsChanged && ArePhotographySettingsApplied();
+			bPhotographySettingsChanged = false;
+			SessionFrame.FramesSinceSessionStart = NumFramesSinceSessionStart;
+			SessionFrame.bCaptureActive = bAnselCaptureActive;
+			SessionFrame.FramesSinceCaptureStart = bAnselCaptureActive ? SessionFrame.FramesSinceCaptureStart + 1 : 0;
+			if (bAnselCaptureActive)
+			{
+				// the SDK moves on to the next tile or panorama view every frame of a capture
+				AnselTrace::CaptureTile(SessionFrame.FramesSinceCaptureStart, AnselCamera.projectionOffsetX, AnselCamera.projectionOffsetY);
+			}
+			SessionFrame.FramesSinceViewChanged = bViewSettled ? SessionFrame.FramesSinceViewChanged + 1 : 0;
+			SessionEvents.OnSessionFrame.Broadcast(SessionFrame);
 		}
 
 		if (bAnselCaptureActive)
@@ -848,6 +1112,7 @@ void FNVAnselCameraPhotographyPrivate::SetCapturedCVar(const char* CVarName, flo
 //渲染配置
 void FNVAnselCameraPhotographyPrivate::ConfigureRenderingSettingsForPhotography(FPostProcessSettings& InOutPostProcessingSettings)
 {
+	ANSEL_TRACE_SCOPE(FNVAnselCameraPhotographyPrivate::ConfigureRenderingSettingsForPhotography);
 #define QUALITY_CVAR(NAME,BOOSTVAL) SetCapturedCVar(NAME, BOOSTVAL, !bHighQualityModeDesired, true)
 #define QUALITY_CVAR_AT_LEAST(NAME,BOOSTVAL) SetCapturedCVarPredicated(NAME, BOOSTVAL, std::greater<float>(), !bHighQualityModeDesired, true)
 #define QUALITY_CVAR_AT_MOST(NAME,BOOSTVAL) SetCapturedCVarPredicated(NAME, BOOSTVAL, std::less<float>(), !bHighQualityModeDesired, true)
@@ -1059,9 +1324,16 @@ void FNVAnselCameraPhotographyPrivate::ConfigureRenderingSettingsForPhotography(
 		 // these are some extreme settings whose quality:risk ratio may be debatable or unproven
 		if (CVarExtreme->GetInt())
 		{
-			// great idea but not until I've proven that this isn't deadly or extremely slow on lower-spec machines:
-			QUALITY_CVAR("r.Streaming.LimitPoolSizeToVRAM", 0); // 0 is aggressive but is it safe? seems safe.
-			QUALITY_CVAR_AT_LEAST("r.Streaming.PoolSize", 3000); // cine - perhaps redundant when r.streaming.fullyloadusedtextures
+			// only lift the pool's VRAM limit as far as the card can actually hold, else texture streaming pages
+			static const IConsoleVariable* CVarStreamingPoolSize = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Streaming.PoolSize"));
+			const int32 CurrentPoolMB = CVarStreamingPoolSize ? CVarStreamingPoolSize->GetInt() : 0;
+			const int32 StreamingPoolMB = FAnselMemoryBudget::Query(CVarPhotographyMemoryHeadroom->GetInt()).GetAffordableStreamingPoolMB(3000, CurrentPoolMB);
+			if (StreamingPoolMB > 0)
+			{
+				QUALITY_CVAR("r.Streaming.LimitPoolSizeToVRAM", 0); // 0 is aggressive, hence the budget above
+				QUALITY_CVAR_AT_LEAST("r.Streaming.PoolSize", StreamingPoolMB); // cine - perhaps redundant when r.streaming.fullyloadusedtextures
+			}
+			UE_LOG(LogAnsel, Log, TEXT("Extreme mode streaming pool: %d MB"), StreamingPoolMB);
 			
 			QUALITY_CVAR("r.streaming.hlodstrategy", 2); // probably use 0 if using r.streaming.fullyloadusedtextures, else 2
 			//QUALITY_CVAR("r.streaming.fullyloadusedtextures", 1); // no - LODs oscillate when overcommitted
@@ -1124,21 +1396,40 @@ void FNVAnselCameraPhotographyPrivate::ConfigureRenderingSettingsForPhotography(
 			InOutPostProcessingSettings.bOverride_MotionBlurAmount = 1;
 			InOutPostProcessingSettings.MotionBlurAmount = 0.f;
 
-			// these effects tile poorly
-			InOutPostProcessingSettings.bOverride_BloomDirtMaskIntensity = 1;
-			InOutPostProcessingSettings.BloomDirtMaskIntensity = 0.f;
-			InOutPostProcessingSettings.bOverride_LensFlareIntensity = 1;
-			InOutPostProcessingSettings.LensFlareIntensity = 0.f;
-			InOutPostProcessingSettings.bOverride_VignetteIntensity = 1;
-			InOutPostProcessingSettings.VignetteIntensity = 0.f;
-			InOutPostProcessingSettings.bOverride_SceneFringeIntensity = 1;
-			InOutPostProcessingSettings.SceneFringeIntensity = 0.f;
-
-			// freeze auto-exposure adaptation 
-			InOutPostProcessingSettings.bOverride_AutoExposureSpeedDown = 0;
-			InOutPostProcessingSettings.AutoExposureSpeedDown = 0.f;
-			InOutPostProcessingSettings.bOverride_AutoExposureSpeedUp = 0;
-			InOutPostProcessingSettings.AutoExposureSpeedUp = 0.f;
+			// these effects are laid out relative to the frame, so they tile poorly; a plain stereo pair
+			// renders each eye as one whole frame though, so it can keep the in-game look
+			const bool bAnselTiledCaptureActive = AnselCaptureInfo.captureType != ansel::kCaptureTypeStereo;
+			if (bAnselTiledCaptureActive)
+			{
+				InOutPostProcessingSettings.bOverride_BloomDirtMaskIntensity = 1;
+				InOutPostProcessingSettings.BloomDirtMaskIntensity = 0.f;
+				InOutPostProcessingSettings.bOverride_LensFlareIntensity = 1;
+				InOutPostProcessingSettings.LensFlareIntensity = 0.f;
+				InOutPostProcessingSettings.bOverride_VignetteIntensity = 1;
+				InOutPostProcessingSettings.VignetteIntensity = 0.f;
+				InOutPostProcessingSettings.bOverride_SceneFringeIntensity = 1;
+				InOutPostProcessingSettings.SceneFringeIntensity = 0.f;
+			}
+
+			if (LockedCaptureExposure > 0.f)
+			{
+				// pin every part of the capture to the whole frame's exposure; with physical camera exposure
+				// off, manual exposure scales scene colour by 2^bias / 1.2
+				InOutPostProcessingSettings.bOverride_AutoExposureMethod = 1;
+				InOutPostProcessingSettings.AutoExposureMethod = AEM_Manual;
+				InOutPostProcessingSettings.bOverride_AutoExposureApplyPhysicalCameraExposure = 1;
+				InOutPostProcessingSettings.AutoExposureApplyPhysicalCameraExposure = 0;
+				InOutPostProcessingSettings.bOverride_AutoExposureBias = 1;
+				InOutPostProcessingSettings.AutoExposureBias = FMath::Log2(LockedCaptureExposure * 1.2f);
+			}
+			else
+			{
+				// freeze auto-exposure adaptation
+				InOutPostProcessingSettings.bOverride_AutoExposureSpeedDown = 1;
+				InOutPostProcessingSettings.AutoExposureSpeedDown = 0.f;
+				InOutPostProcessingSettings.bOverride_AutoExposureSpeedUp = 1;
+				InOutPostProcessingSettings.AutoExposureSpeedUp = 0.f;
+			}
 
 			// bring rendering up to (at least) full resolution
 			if (InOutPostProcessingSettings.ScreenPercentage_DEPRECATED < 100.f)
@@ -1171,6 +1462,79 @@ void FNVAnselCameraPhotographyPrivate::ConfigureRenderingSettingsForPhotography(
 			}
 		}
 	}
+	if (bAnselCaptureActive || (GIsHighResScreenshot && !bGradingOnReadback))
+	{
+		ApplyGradingLUT(InOutPostProcessingSettings);
+	}
+}
+
+void FNVAnselCameraPhotographyPrivate::RefreshGradingLUT()
+{
+	const FString Filename = CVarPhotographyGradingLUT->GetString();
+	if (Filename == GradingLUTFilename)
+	{
+		return;
+	}
+
+	GradingLUTFilename = Filename;
+	GradingLUT.Reset();
+	GradingLUTTexture.Reset();
+	bGradingLUTTextureStale = true;
+	if (!Filename.IsEmpty())
+	{
+		TSharedPtr<FAnselGradingLUT> NewLUT = MakeShared<FAnselGradingLUT>();
+		FString Error;
+		if (!NewLUT->LoadCubeFile(Filename, Error))
+		{
+			UE_LOG(LogAnsel, Warning, TEXT("Can't grade captures with LUT %s: %s"), *Filename, *Error);
+			return;
+		}
+		if (NewLUT->GetSize() > 16)
+		{
+			UE_LOG(LogAnsel, Warning, TEXT("LUT %s is %d^3, but the tonemapper grades Ansel captures through a 16^3 LUT, so only batch shots get the full table"), *Filename, NewLUT->GetSize());
+		}
+		GradingLUT = NewLUT;
+	}
+}
+
+TSharedPtr<const FAnselGradingLUT> FNVAnselCameraPhotographyPrivate::GetGradingLUT()
+{
+	RefreshGradingLUT();
+	return GradingLUT;
+}
+
+void FNVAnselCameraPhotographyPrivate::ApplyGradingLUT(FPostProcessSettings& InOutPostProcessingSettings)
+{
+	RefreshGradingLUT();
+	if (!GradingLUT.IsValid())
+	{
+		return;
+	}
+
+	// the scene's own grade goes first, so the LUT finishes the look rather than replacing it
+	UTexture* SceneLUT = InOutPostProcessingSettings.ColorGradingLUT;
+	const float SceneLUTIntensity = SceneLUT ? InOutPostProcessingSettings.ColorGradingIntensity : 0.f;
+	if (bGradingLUTTextureStale || GradingLUTTextureBase.Get() != SceneLUT || GradingLUTTextureBaseIntensity != SceneLUTIntensity)
+	{
+		bGradingLUTTextureStale = false;
+		GradingLUTTextureBase = SceneLUT;
+		GradingLUTTextureBaseIntensity = SceneLUTIntensity;
+		UTexture2D* SceneLUT2D = Cast<UTexture2D>(SceneLUT);
+		GradingLUTTexture.Reset(SceneLUT && !SceneLUT2D ? nullptr : GradingLUT->CreateTexture(FName(*FPaths::GetBaseFilename(GradingLUTFilename)), SceneLUT2D, SceneLUTIntensity));
+		if (!GradingLUTTexture.IsValid())
+		{
+			UE_LOG(LogAnsel, Warning, TEXT("Can't combine LUT %s with the scene's colour grading LUT %s in this build, so Ansel captures keep the scene's grade alone"),
+				*GradingLUTFilename, *GetNameSafe(SceneLUT));
+		}
+	}
+
+	if (GradingLUTTexture.IsValid())
+	{
+		InOutPostProcessingSettings.bOverride_ColorGradingLUT = 1;
+		InOutPostProcessingSettings.ColorGradingLUT = GradingLUTTexture.Get();
+		InOutPostProcessingSettings.bOverride_ColorGradingIntensity = 1;
+		InOutPostProcessingSettings.ColorGradingIntensity = 1.f;
+	}
 }
 
 
@@ -1191,7 +1555,9 @@ void FNVAnselCameraPhotographyPrivate::SetUpSessionCVars()
 
 void FNVAnselCameraPhotographyPrivate::UpdatePostProcessing(FPostProcessSettings& InOutPostProcessingSettings)
 {
-	
+	ANSEL_TRACE_SCOPE(FNVAnselCameraPhotographyPrivate::UpdatePostProcessing);
+	LLM_SCOPE_BYTAG(Ansel);
+
 	if (bAnselSessionActive)
 	{
 		DoCustomUIControls(InOutPostProcessingSettings, bUIControlsNeedRebuild);
@@ -1200,21 +1566,71 @@ void FNVAnselCameraPhotographyPrivate::UpdatePostProcessing(FPostProcessSettings
 	}
 }
 
+void FNVAnselCameraPhotographyPrivate::SetSessionViewOverride(const FMinimalViewInfo& View, bool bHighQuality)
+{
+	SessionViewOverride = View;
+	bSessionViewOverridePending = true;
+	bHighQualityModeDesired = bHighQuality;
+}
+
+bool FNVAnselCameraPhotographyPrivate::StepPausedWorld(int32 NumSteps)
+{
+	if (!bAnselSessionActive || !bAutoPause || bWasPausedBeforeSession)
+	{
+		return false;
+	}
+	PendingWorldSteps += FMath::Max(NumSteps, 0);
+	return true;
+}
+
+bool FNVAnselCameraPhotographyPrivate::ArePhotographySettingsApplied() const
+{
+	// high quality mode is only applied once the game has actually paused, see ConfigureRenderingSettingsForPhotography
+	const bool bHighQualityModePending = CVarAllowHighQuality.GetValueOnAnyThread() && bHighQualityModeIsSetup != bHighQualityModeDesired;
+
+	return !bUIControlsNeedRebuild &&
+		!bHighQualityModePending &&
+		bHighLodIsSetup == bHighLodDesired &&
+		bHighLumenIsSetup == bHighLumenDesired &&
+		bHighSkyLightIsSetup == bHighSkyLightDesired &&
+		bHighAntiAliasingIsSetup == bHighAntiAliasingDesired &&
+		bHighSgQualityIsSetup == bHighSgQualityDesired;
+}
+
+EAnselCaptureType FNVAnselCameraPhotographyPrivate::GetCaptureType() const
+{
+	switch (AnselCaptureInfo.captureType)
+	{
+	case ansel::kCaptureType360Mono:		return EAnselCaptureType::Mono360;
+	case ansel::kCaptureType360Stereo:		return EAnselCaptureType::Stereo360;
+	case ansel::kCaptureTypeStereo:			return EAnselCaptureType::Stereo;
+	case ansel::kCaptureTypeSuperResolution:
+	default:								return EAnselCaptureType::SuperResolution;
+	}
+}
+
 void FNVAnselCameraPhotographyPrivate::StartSession()
 {
-	
-	
-	ansel::startSession();
-	
+	if (bAnselInitialized)
+	{
+		ANSEL_TRACE_SCOPE(AnselSDK_startSession);
+		ansel::startSession();
+	}
 }
 
 void FNVAnselCameraPhotographyPrivate::StopSession()
 {
-	ansel::stopSession();
+	if (bAnselInitialized)
+	{
+		ANSEL_TRACE_SCOPE(AnselSDK_stopSession);
+		ansel::stopSession();
+	}
 }
 
 void FNVAnselCameraPhotographyPrivate::DefaultConstrainCamera(const FVector NewCameraLocation, const FVector PreviousCameraLocation, const FVector OriginalCameraLocation, FVector& OutCameraLocation, APlayerCameraManager* PCMgr)
 {
+	ANSEL_TRACE_SCOPE(FNVAnselCameraPhotographyPrivate::DefaultConstrainCamera);
+
 	// let proposed camera through unmodified by default
 	OutCameraLocation = NewCameraLocation;
 
@@ -1224,7 +1640,14 @@ void FNVAnselCameraPhotographyPrivate::DefaultConstrainCamera(const FVector NewC
 	UAnselFunctionLibrary::ConstrainCameraByDistance(PCMgr, NewCameraLocation, PreviousCameraLocation, OriginalCameraLocation, ConstrainedLocation, MaxDistance);
 
 	// Second, constrain against collision geometry
-	UAnselFunctionLibrary::ConstrainCameraByGeometry(PCMgr, ConstrainedLocation, PreviousCameraLocation, OriginalCameraLocation, OutCameraLocation);
+	if (CVarConstrainCameraAsync->GetInt())
+	{
+		GeometryConstraint.ConstrainAsync(PCMgr->GetWorld(), ConstrainedLocation, PreviousCameraLocation, CVarConstrainCameraSize->GetFloat(), CVarConstrainCameraAsyncMaxStep->GetFloat(), OutCameraLocation);
+	}
+	else
+	{
+		GeometryConstraint.Constrain(PCMgr->GetWorld(), ConstrainedLocation, PreviousCameraLocation, OriginalCameraLocation, CVarConstrainCameraSize->GetFloat(), OutCameraLocation);
+	}
 }
 
 ansel::StartSessionStatus FNVAnselCameraPhotographyPrivate::AnselStartSessionCallback(ansel::SessionConfiguration& settings, void* userPointer)
@@ -1306,44 +1729,67 @@ void FNVAnselCameraPhotographyPrivate::AnselChangeQualityCallback(bool isHighQua
 	UE_LOG(LogAnsel, Log, TEXT("Photography HQ mode toggle (%d)"), (int)isHighQuality);
 }
 
+void FNVAnselCameraPhotographyPrivate::FlushPendingReconfigure()
+{
+	if (bReconfigurePending)
+	{
+		bReconfigurePending = false;
+		ReconfigureAnsel();
+	}
+}
+
 void FNVAnselCameraPhotographyPrivate::ReconfigureAnsel()
 {
 	check(AnselConfig != nullptr);
-	AnselConfig->userPointer = this;
-	AnselConfig->startSessionCallback = AnselStartSessionCallback;
-	AnselConfig->stopSessionCallback = AnselStopSessionCallback;
-	AnselConfig->startCaptureCallback = AnselStartCaptureCallback;
-	AnselConfig->stopCaptureCallback = AnselStopCaptureCallback;
-	AnselConfig->changeQualityCallback = AnselChangeQualityCallback;
+	ansel::Configuration NewConfig = *AnselConfig;
+	NewConfig.userPointer = this;
+	NewConfig.startSessionCallback = AnselStartSessionCallback;
+	NewConfig.stopSessionCallback = AnselStopSessionCallback;
+	NewConfig.startCaptureCallback = AnselStartCaptureCallback;
+	NewConfig.stopCaptureCallback = AnselStopCaptureCallback;
+	NewConfig.changeQualityCallback = AnselChangeQualityCallback;
 
 	// Getting fovType wrong can lead to multi-part captures stitching incorrectly, especially 360 shots
-	AnselConfig->fovType = RequiredFovType;
+	NewConfig.fovType = RequiredFovType;
 	
-	if (GEngine->GameViewport && GEngine->GameViewport->GetWindow().IsValid() && GEngine->GameViewport->GetWindow()->GetNativeWindow().IsValid())
+	if (void* const GameWindowHandle = GetGameWindowHandle())
 	{
-		AnselConfig->gameWindowHandle = GEngine->GameViewport->GetWindow()->GetNativeWindow()->GetOSWindowHandle();
+		NewConfig.gameWindowHandle = GameWindowHandle;
 	}
-	UE_LOG(LogAnsel, Log, TEXT("gameWindowHandle= %p"), AnselConfig->gameWindowHandle);
 
-	AnselConfig->translationalSpeedInWorldUnitsPerSecond = CVarPhotographyTranslationSpeed->GetFloat();
+	NewConfig.translationalSpeedInWorldUnitsPerSecond = CVarPhotographyTranslationSpeed->GetFloat();
 
-	AnselConfig->metersInWorldUnit = 1.0f / RequiredWorldToMeters;
-	UE_LOG(LogAnsel, Log, TEXT("We reckon %f meters to 1 world unit"), AnselConfig->metersInWorldUnit);
+	NewConfig.metersInWorldUnit = 1.0f / RequiredWorldToMeters;
+
+	NewConfig.isCameraOffcenteredProjectionSupported = true;
 
-	AnselConfig->isCameraOffcenteredProjectionSupported = true;
+	NewConfig.captureLatency = 0; // important
 
-	AnselConfig->captureLatency = 0; // important
+	NewConfig.captureSettleLatency = CVarPhotographySettleFrames->GetInt();
+
+	// only hit the SDK when something it cares about actually differs from what it already has
+	const bool bConfigChanged = !bAnselConfigured ||
+		NewConfig.fovType != AnselConfig->fovType ||
+		NewConfig.gameWindowHandle != AnselConfig->gameWindowHandle ||
+		NewConfig.translationalSpeedInWorldUnitsPerSecond != AnselConfig->translationalSpeedInWorldUnitsPerSecond ||
+		NewConfig.metersInWorldUnit != AnselConfig->metersInWorldUnit ||
+		NewConfig.captureSettleLatency != AnselConfig->captureSettleLatency;
+	if (!bConfigChanged)
+	{
+		return;
+	}
 
-	AnselConfig->captureSettleLatency = CVarPhotographySettleFrames->GetInt();
+	*AnselConfig = NewConfig;
+	UE_LOG(LogAnsel, Log, TEXT("gameWindowHandle= %p"), AnselConfig->gameWindowHandle);
+	UE_LOG(LogAnsel, Log, TEXT("We reckon %f meters to 1 world unit"), AnselConfig->metersInWorldUnit);
 
+	ANSEL_TRACE_SCOPE(AnselSDK_setConfiguration);
 	ansel::SetConfigurationStatus status = ansel::setConfiguration(*AnselConfig);
 	if (status != ansel::kSetConfigurationSuccess)
 	{
 		UE_LOG(LogAnsel, Log, TEXT("ReconfigureAnsel setConfiguration returned %ld"), (long int)(status));
 	}
-
-	CurrentlyConfiguredFovType = RequiredFovType;
-	CurrentlyConfiguredWorldToMeters = RequiredWorldToMeters;
+	bAnselConfigured = true;
 }
 
 void FNVAnselCameraPhotographyPrivate::DeconfigureAnsel()
@@ -1356,6 +1802,8 @@ void FNVAnselCameraPhotographyPrivate::DeconfigureAnsel()
 	AnselConfig->startCaptureCallback = nullptr;
 	AnselConfig->stopCaptureCallback = nullptr;
 	AnselConfig->gameWindowHandle = nullptr;
+	bAnselConfigured = false;
+	ANSEL_TRACE_SCOPE(AnselSDK_setConfiguration);
 	ansel::SetConfigurationStatus status = ansel::setConfiguration(*AnselConfig);
 	if (status != ansel::kSetConfigurationSuccess)
 	{
@@ -1363,11 +1811,331 @@ void FNVAnselCameraPhotographyPrivate::DeconfigureAnsel()
 	}
 }
 
+// Lets -AnselBatch drive the photography provider and the engine's high resolution screenshots
+class FAnselBatchHost : public IAnselBatchHost
+{
+public:
+	// the provider is looked up whenever it's wanted, as the manager may make or replace it at any time
+	FAnselBatchHost(TFunction<TSharedPtr<FNVAnselCameraPhotographyPrivate>()> InGetProvider)
+		: GetProvider(MoveTemp(InGetProvider))
+	{
+	}
+
+	virtual ~FAnselBatchHost()
+	{
+		EndCapture();
+		BindScreenshotCaptured(false);
+	}
+
+	virtual bool IsReady() const override
+	{
+		TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = GetProvider();
+		UWorld* World = GetWorld();
+		return PinnedProvider.IsValid() && PinnedProvider->IsSupported() &&
+			World && World->HasBegunPlay() && World->GetFirstPlayerController() != nullptr;
+	}
+
+	virtual void StartSession() override
+	{
+		UAnselFunctionLibrary::StartSession(GetWorld());
+	}
+
+	virtual void StopSession() override
+	{
+		UAnselFunctionLibrary::StopSession(GetWorld());
+	}
+
+	virtual void SetShotView(const FAnselBatchShot& Shot) override
+	{
+		if (TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = GetProvider())
+		{
+			FMinimalViewInfo View;
+			View.Location = Shot.Location;
+			View.Rotation = Shot.Rotation;
+			View.FOV = Shot.FOV;
+			PinnedProvider->SetSessionViewOverride(View, Shot.bHighQuality);
+		}
+	}
+
+	virtual bool StartCapture(const FAnselBatchShot& Shot, const FString& Filename) override
+	{
+		// the SDK has no way to start its own multi-part captures without the overlay, so unattended
+		// stills go through the engine's high resolution screenshot instead
+		if (Shot.CaptureType != EAnselCaptureType::SuperResolution || !GEngine->GameViewport || !GEngine->GameViewport->Viewport)
+		{
+			return false;
+		}
+
+		// a supersampled or accumulated shot comes back through the delegate to be filtered or averaged
+		// before it's written
+		CaptureShot = Shot;
+		CaptureShot.Supersample = GetSupersample(Shot);
+		if (CaptureShot.Supersample != Shot.Supersample)
+		{
+			UE_LOG(LogAnsel, Warning, TEXT("Shot %s: supersampling %dx instead of %dx, to stay within the largest texture the RHI allows"), *Shot.Name, CaptureShot.Supersample, Shot.Supersample);
+		}
+		CaptureFilename = Filename;
+		bAccumulating = Shot.Accumulation.MaxSamples > 1;
+		if (bAccumulating)
+		{
+			Accumulator.Reset(Shot.Accumulation);
+		}
+		LastCaptureStats = FAnselAccumulationStats();
+		LastCaptureStats.NumSamples = 1;
+		bCaptureDropped = false;
+
+		// 8-bit shots are graded through the full LUT as they're read back, rather than the tonemapper's 16^3
+		// resampling of it; HDR shots aren't read back as 8-bit, so they keep the tonemapper's
+		TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = GetProvider();
+		CaptureGradingLUT = PinnedProvider.IsValid() && !Shot.bHDR ? PinnedProvider->GetGradingLUT() : nullptr;
+		if (PinnedProvider.IsValid())
+		{
+			PinnedProvider->SetGradingOnReadback(CaptureGradingLUT.IsValid());
+		}
+		BindScreenshotCaptured(FrameSink != nullptr || CaptureShot.Supersample > 1 || bAccumulating || CaptureGradingLUT.IsValid());
+
+		RequestScreenshot();
+		return true;
+	}
+
+	virtual bool ContinueCapture() override
+	{
+		if (bAccumulating)
+		{
+			// no samples at all means the screenshot never came back, so there's nothing to go on
+			if (Accumulator.GetNumSamples() > 0 && !Accumulator.IsConverged())
+			{
+				RequestScreenshot();
+				return true;
+			}
+
+			bAccumulating = false;
+			LastCaptureStats = Accumulator.GetStats();
+			if (LastCaptureStats.NumSamples > 0)
+			{
+				UE_LOG(LogAnsel, Log, TEXT("Shot %s: averaged %d of up to %d samples down to a noise of %.2f levels"),
+					*CaptureShot.Name, LastCaptureStats.NumSamples, LastCaptureStats.NumFixedSamples, Accumulator.GetNoise());
+				TArray<FColor> Resolved;
+				Accumulator.Resolve(Resolved);
+				WriteFrame(Resolved.GetData(), Accumulator.GetSize());
+			}
+		}
+
+		EndCapture();
+		return false;
+	}
+
+	virtual FAnselAccumulationStats GetCaptureStats() const override
+	{
+		return LastCaptureStats;
+	}
+
+	virtual bool WasCaptureDropped() const override
+	{
+		return bCaptureDropped;
+	}
+
+	virtual bool IsCaptureInProgress() const override
+	{
+		return GIsHighResScreenshot; // cleared by the viewport once the shot is written
+	}
+
+	virtual bool CanAffordCapture(const FAnselBatchShot& Shot, FString& OutReason) const override
+	{
+		// HighResShot refuses anything bigger than the RHI's largest texture, but setting GIsHighResScreenshot
+		// directly skips that check, so it's made here instead
+		const FIntPoint CaptureResolution = GetCaptureResolution(Shot);
+		const int32 MaxTextureDimension = int32(GetMax2DTextureDimension());
+		if (CaptureResolution.X <= 0 || CaptureResolution.Y <= 0 || CaptureResolution.GetMax() > MaxTextureDimension)
+		{
+			OutReason = FString::Printf(TEXT("renders at %dx%d, which must be 1 to %d on each axis"), CaptureResolution.X, CaptureResolution.Y, MaxTextureDimension);
+			return false;
+		}
+
+		FAnselMemoryBudget Budget = FAnselMemoryBudget::Query(CVarPhotographyMemoryHeadroom->GetInt());
+		if (Shot.Accumulation.MaxSamples > 1)
+		{
+			// the accumulation buffers are held for the whole shot, so the screenshots get what's left
+			const uint64 AccumulationBytes = FAnselFrameAccumulator::GetMemoryRequired(GetOutputResolution(Shot));
+			if (AccumulationBytes > Budget.AvailablePhysical)
+			{
+				OutReason = FString::Printf(TEXT("accumulating needs ~%llu MB of RAM, %llu MB free"), AccumulationBytes >> 20, Budget.AvailablePhysical >> 20);
+				return false;
+			}
+			Budget.AvailablePhysical -= AccumulationBytes;
+		}
+		return Budget.CanAffordScreenshot(CaptureResolution, Shot.bHDR, OutReason);
+	}
+
+	virtual bool StepWorld(int32 NumSteps) override
+	{
+		TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = GetProvider();
+		return PinnedProvider.IsValid() && PinnedProvider->StepPausedWorld(NumSteps);
+	}
+
+	virtual bool IsSteppingWorld() const override
+	{
+		TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = GetProvider();
+		return PinnedProvider.IsValid() && PinnedProvider->IsSteppingPausedWorld();
+	}
+
+	virtual void SetFrameSink(FAnselFrameRing* InFrameSink) override
+	{
+		FrameSink = InFrameSink;
+		BindScreenshotCaptured(FrameSink != nullptr);
+	}
+
+	virtual double GetTimeSeconds() const override
+	{
+		return FPlatformTime::Seconds();
+	}
+
+	virtual int32 GetDefaultSettleFrames() const override
+	{
+		return CVarPhotographySettleFrames->GetInt();
+	}
+
+	virtual void GetMemoryUsage(uint64& OutUsedPhysical, uint64& OutUsedGPU) const override
+	{
+		OutUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+
+		FTextureMemoryStats TextureMemoryStats;
+		RHIGetTextureMemoryStats(TextureMemoryStats);
+		OutUsedGPU = TextureMemoryStats.AllocatedMemorySize > 0 ? uint64(TextureMemoryStats.AllocatedMemorySize) : 0;
+	}
+
+private:
+	static UWorld* GetWorld()
+	{
+		return GEngine && GEngine->GameViewport ? GEngine->GameViewport->GetWorld() : nullptr;
+	}
+
+	/** The size of the image written for the shot */
+	static FIntPoint GetOutputResolution(const FAnselBatchShot& Shot)
+	{
+		if (Shot.Resolution.X > 0 && Shot.Resolution.Y > 0)
+		{
+			return Shot.Resolution;
+		}
+		return GEngine->GameViewport && GEngine->GameViewport->Viewport ? GEngine->GameViewport->Viewport->GetSizeXY() : FIntPoint::ZeroValue;
+	}
+
+	/** The shot's supersample factor, or the largest below it at which the shot still fits in a texture */
+	static int32 GetSupersample(const FAnselBatchShot& Shot)
+	{
+		const int32 OutputDimension = FMath::Max(GetOutputResolution(Shot).GetMax(), 1);
+		return FMath::Clamp(int32(GetMax2DTextureDimension()) / OutputDimension, 1, Shot.Supersample);
+	}
+
+	/** The size the shot renders at, which is bigger than the image written if it's supersampled */
+	static FIntPoint GetCaptureResolution(const FAnselBatchShot& Shot)
+	{
+		return GetOutputResolution(Shot) * GetSupersample(Shot);
+	}
+
+	void RequestScreenshot()
+	{
+		const FIntPoint Resolution = GetCaptureResolution(CaptureShot);
+		FHighResScreenshotConfig& Config = GetHighResScreenshotConfig();
+		Config.SetResolution(Resolution.X, Resolution.Y);
+		Config.SetHDRCapture(CaptureShot.bHDR);
+		Config.FilenameOverride = CaptureFilename;
+		GIsHighResScreenshot = true;
+	}
+
+	/** Hands tonemapper grading back to the provider once a shot's last screenshot is done */
+	void EndCapture()
+	{
+		if (CaptureGradingLUT.IsValid())
+		{
+			CaptureGradingLUT.Reset();
+			if (TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = GetProvider())
+			{
+				PinnedProvider->SetGradingOnReadback(false);
+			}
+		}
+	}
+
+	// while the delegate is bound the viewport hands it the pixels instead of writing the file
+	void BindScreenshotCaptured(bool bBind)
+	{
+		if (bBind && !ScreenshotCapturedHandle.IsValid())
+		{
+			ScreenshotCapturedHandle = UGameViewportClient::OnScreenshotCaptured().AddRaw(this, &FAnselBatchHost::HandleScreenshotCaptured);
+		}
+		else if (!bBind && ScreenshotCapturedHandle.IsValid())
+		{
+			UGameViewportClient::OnScreenshotCaptured().Remove(ScreenshotCapturedHandle);
+			ScreenshotCapturedHandle.Reset();
+		}
+	}
+
+	void HandleScreenshotCaptured(int32 Width, int32 Height, const TArray<FColor>& Pixels)
+	{
+		if (!GIsHighResScreenshot)
+		{
+			return;
+		}
+
+		FIntPoint Size(Width, Height);
+		const FColor* Frame = Pixels.GetData();
+		TArray<FColor> Downsampled;
+		if (CaptureShot.Supersample > 1)
+		{
+			AnselImage::DownsampleLanczos3(Pixels.GetData(), FIntPoint(Width, Height), CaptureShot.Supersample, Downsampled, Size);
+			Frame = Downsampled.GetData();
+		}
+
+		if (bAccumulating)
+		{
+			Accumulator.AddSample(Frame, Size);
+		}
+		else
+		{
+			WriteFrame(Frame, Size);
+		}
+	}
+
+	void WriteFrame(const FColor* Frame, FIntPoint Size)
+	{
+		// graded last, so the LUT sees the same pixels the tonemapper would have given it
+		TArray<FColor> Graded;
+		if (CaptureGradingLUT.IsValid())
+		{
+			Graded.SetNumUninitialized(Size.X * Size.Y);
+			CaptureGradingLUT->Apply(Frame, Graded.GetData(), Size);
+			Frame = Graded.GetData();
+		}
+
+		if (FrameSink)
+		{
+			bCaptureDropped = !FrameSink->Publish(Size.X, Size.Y, Frame, CaptureShot.Index, CaptureShot.SequenceSeconds);
+		}
+		else if (!FImageUtils::SaveImageByExtension(*CaptureFilename, FImageView(Frame, Size.X, Size.Y)))
+		{
+			UE_LOG(LogAnsel, Warning, TEXT("Couldn't write shot %s"), *CaptureFilename);
+		}
+	}
+
+	TFunction<TSharedPtr<FNVAnselCameraPhotographyPrivate>()> GetProvider;
+	FAnselFrameRing* FrameSink = nullptr;
+	FDelegateHandle ScreenshotCapturedHandle;
+	FAnselBatchShot CaptureShot;
+	FString CaptureFilename;
+	TSharedPtr<const FAnselGradingLUT> CaptureGradingLUT;
+	bool bAccumulating = false;
+	FAnselFrameAccumulator Accumulator;
+	FAnselAccumulationStats LastCaptureStats;
+	bool bCaptureDropped = false;
+};
+
 class FAnselModule : public IAnselModule
 {
 public:
 	virtual void StartupModule() override
 	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(FAnselModule::StartupModule);
+		LLM_SCOPE_BYTAG(Ansel);
 		ICameraPhotographyModule::StartupModule();
 		check(!bAnselDLLLoaded);
 
@@ -1378,15 +2146,50 @@ public:
 #define STRINGIFY(X) STRINGIFY2(X)
 #define STRINGIFY2(X) #X
 			AnselDLLName = AnselBinariesRoot + TEXT(STRINGIFY(ANSEL_DLL));
+
+		// Loading the DLL can take a while and this module loads at PostConfigInit, so do it on its own
+		// thread; the photography provider reports itself unavailable until the task has finished.  The
+		// SDK promises nothing about thread safety, so the task makes no SDK calls itself.
+		SDKLoadTask = Async(EAsyncExecution::Thread, [AnselDLLName]()
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(AnselLoadSDK);
+			const double StartTime = FPlatformTime::Seconds();
+
 			AnselSDKDLLHandle = FPlatformProcess::GetDllHandle(*(AnselDLLName));
-		
-		bAnselDLLLoaded = AnselSDKDLLHandle != 0;
-		UE_LOG(LogAnsel, Log, TEXT("Tried to load %s : success=%d"), *AnselDLLName, int(bAnselDLLLoaded));
-		
+			bAnselDLLLoaded = AnselSDKDLLHandle != 0;
+
+			UE_LOG(LogAnsel, Log, TEXT("Tried to load %s : success=%d (%.2f ms)"), *AnselDLLName, int(bAnselDLLLoaded), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		});
+
+		// the rest of the SDK hook-up happens on the game thread once the load has finished
+		SDKLoadedTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+		{
+			if (!SDKLoadTask.IsReady())
+			{
+				return true;
+			}
+			HandleSDKLoaded();
+			SDKLoadedTickerHandle.Reset();
+			return false;
+		}));
+
+		// the manifest refers to reflected types, so it can't be read this early in startup
+		PostEngineInitHandle = FCoreDelegates::OnPostEngineInit.AddLambda([this]()
+		{
+			BatchRunner = FAnselBatchRunner::CreateFromCommandLine(SessionEvents, MakeUnique<FAnselBatchHost>([this]() { return Provider.Pin(); }));
+		});
 	}
 
 	virtual void ShutdownModule() override
-	{		
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(SDKLoadedTickerHandle);
+		FCoreDelegates::OnPostEngineInit.Remove(PostEngineInitHandle);
+		BatchRunner.Reset();
+		CaptureHost.Reset();
+		if (SDKLoadTask.IsValid())
+		{
+			SDKLoadTask.Wait();
+		}
 		if (bAnselDLLLoaded)
 		{
 			FPlatformProcess::FreeDllHandle(AnselSDKDLLHandle);
@@ -1395,24 +2198,139 @@ public:
 		}
 		ICameraPhotographyModule::ShutdownModule();
 	}
+
+	virtual void RegisterUserControl(const FAnselUserControlDesc& Desc) override
+	{
+		FAnselUserControlRegistry::Get().Register(Desc);
+	}
+
+	virtual void UnregisterUserControl(FName Name) override
+	{
+		FAnselUserControlRegistry::Get().Unregister(Name);
+	}
+
+	virtual FAnselSessionEvents& GetSessionEvents() override
+	{
+		return SessionEvents;
+	}
+
+	virtual bool StartSuperResolutionCapture(int32 Multiplier, const FString& Filename, FString& OutError) override
+	{
+		check(IsInGameThread());
+		// the screenshot hook only has room for one taker, and a batch run keeps it for its own shots
+		if (BatchRunner.IsValid())
+		{
+			OutError = TEXT("a batch run is capturing");
+			return false;
+		}
+		if (!SessionEvents.bSessionActive)
+		{
+			OutError = TEXT("there's no photography session");
+			return false;
+		}
+		if (IsSuperResolutionCaptureInProgress() || GIsHighResScreenshot)
+		{
+			OutError = TEXT("a capture is already being taken");
+			return false;
+		}
+		if (!GEngine->GameViewport || !GEngine->GameViewport->Viewport)
+		{
+			OutError = TEXT("there's no game viewport");
+			return false;
+		}
+
+		// the same path batch shots take, at the session's own view rather than a scripted one
+		const FString CaptureFilename = !Filename.IsEmpty() ? Filename :
+			FPaths::Combine(FPaths::ScreenShotDir(), FString::Printf(TEXT("AnselSuperResolution_%s.png"), *FDateTime::Now().ToString()));
+		FAnselBatchShot Shot;
+		Shot.Name = FPaths::GetBaseFilename(CaptureFilename);
+		Shot.CaptureType = EAnselCaptureType::SuperResolution;
+		Shot.Resolution = GEngine->GameViewport->Viewport->GetSizeXY() * FMath::Max(Multiplier, 1);
+		if (!CaptureHost.IsValid())
+		{
+			CaptureHost = MakeUnique<FAnselBatchHost>([this]() { return Provider.Pin(); });
+		}
+		if (!CaptureHost->CanAffordCapture(Shot, OutError))
+		{
+			return false;
+		}
+		if (!CaptureHost->StartCapture(Shot, CaptureFilename))
+		{
+			OutError = TEXT("the high resolution screenshot couldn't be started");
+			return false;
+		}
+		bSuperResolutionCaptureActive = true;
+		return true;
+	}
+
+	virtual bool IsSuperResolutionCaptureInProgress() override
+	{
+		if (bSuperResolutionCaptureActive && !CaptureHost->IsCaptureInProgress() && !CaptureHost->ContinueCapture())
+		{
+			bSuperResolutionCaptureActive = false;
+		}
+		return bSuperResolutionCaptureActive;
+	}
+
+	virtual int32 GetSettleFrames() const override
+	{
+		return CVarPhotographySettleFrames->GetInt();
+	}
+
 private:
 
 	virtual TSharedPtr< class ICameraPhotography > CreateCameraPhotography() override
 	{
-		TSharedPtr<ICameraPhotography> Photography = nullptr;
+		// without the SDK there's nothing to provide, so leave the way clear for any other provider
+		const bool bSDKLoadFinished = SDKLoadTask.IsReady();
+		if (bSDKLoadFinished && !bAnselDLLLoaded)
+		{
+			return nullptr;
+		}
 
-		FNVAnselCameraPhotographyPrivate* PhotographyPrivate = new FNVAnselCameraPhotographyPrivate();
-		if (PhotographyPrivate->IsSupported())
+		// while the SDK is still loading the provider reports itself as unsupported until it's ready
+		TSharedPtr<FNVAnselCameraPhotographyPrivate> NewProvider = MakeShareable(new FNVAnselCameraPhotographyPrivate(SessionEvents));
+		if (bSDKLoadFinished && IsInGameThread())
 		{
-			Photography = TSharedPtr<ICameraPhotography>(PhotographyPrivate);
+			NewProvider->InitializeAnsel();
 		}
-		else
+		Provider = NewProvider;
+		return NewProvider;
+	}
+
+	void HandleSDKLoaded()
+	{
+		check(IsInGameThread());
+		TSharedPtr<FNVAnselCameraPhotographyPrivate> PinnedProvider = Provider.Pin();
+		if (!PinnedProvider.IsValid())
 		{
-			delete PhotographyPrivate;
+			return;
 		}
 
-		return Photography;
+		if (bAnselDLLLoaded)
+		{
+			PinnedProvider->InitializeAnsel();
+		}
+		else
+		{
+			// the provider handed out while the SDK was loading can never work; have the manager ask the
+			// providers again, which passes this one over now
+			Provider.Reset();
+			PinnedProvider.Reset();
+			FCameraPhotographyManager::Destroy();
+		}
 	}
+
+	TFuture<void> SDKLoadTask;
+	FTSTicker::FDelegateHandle SDKLoadedTickerHandle;
+	FAnselSessionEvents SessionEvents;
+	TWeakPtr<FNVAnselCameraPhotographyPrivate> Provider;
+	TUniquePtr<FAnselBatchRunner> BatchRunner;
+
+	// takes the Blueprint super-resolution captures, outside of any batch run
+	TUniquePtr<FAnselBatchHost> CaptureHost;
+	bool bSuperResolutionCaptureActive = false;
+	FDelegateHandle PostEngineInitHandle;
 };
 
 IMPLEMENT_MODULE(FAnselModule, Ansel)
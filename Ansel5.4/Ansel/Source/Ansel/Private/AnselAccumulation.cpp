@@ -0,0 +1,208 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselAccumulation.h"
+
+#include "AnselTrace.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogAnselAccumulation, Log, All);
+
+// a variance needs two samples
+static const int32 MinSamplesForNoise = 2;
+
+// small enough that a patch of sky isn't held back by the foliage next to it, big enough that a tile's
+// noise is an average over plenty of pixels
+static const int32 TileSize = 64;
+
+static float GetLuma(const FColor& Color)
+{
+	return 0.2126f * Color.R + 0.7152f * Color.G + 0.0722f * Color.B;
+}
+
+void FAnselTileSampleAllocator::Reset(int32 InNumTiles, const FAnselAccumulationSettings& InSettings)
+{
+	Settings = InSettings;
+	NumSamples = 0;
+	NumActiveTiles = InNumTiles;
+	TileSamples.Init(0, InNumTiles);
+	bTileConverged.Init(false, InNumTiles);
+}
+
+void FAnselTileSampleAllocator::AddSample(TArrayView<const float> TileNoise)
+{
+	check(TileNoise.Num() == TileSamples.Num());
+
+	++NumSamples;
+	for (int32 Tile = 0; Tile < TileSamples.Num(); ++Tile)
+	{
+		if (bTileConverged[Tile])
+		{
+			continue;
+		}
+
+		++TileSamples[Tile];
+		if (Settings.NoiseTarget > 0.f && TileSamples[Tile] >= MinSamplesForNoise && TileNoise[Tile] <= Settings.NoiseTarget)
+		{
+			bTileConverged[Tile] = true;
+			--NumActiveTiles;
+		}
+	}
+}
+
+bool FAnselTileSampleAllocator::IsFinished() const
+{
+	return NumSamples >= Settings.MaxSamples || NumActiveTiles == 0;
+}
+
+FAnselAccumulationStats FAnselTileSampleAllocator::GetStats() const
+{
+	FAnselAccumulationStats Stats;
+	Stats.NumSamples = NumSamples;
+	Stats.NumFixedSamples = Settings.MaxSamples;
+	return Stats;
+}
+
+uint64 FAnselFrameAccumulator::GetMemoryRequired(FIntPoint Size)
+{
+	return uint64(FMath::Max(Size.X, 0)) * uint64(FMath::Max(Size.Y, 0)) * (sizeof(FLinearColor) + sizeof(FVector2f));
+}
+
+void FAnselFrameAccumulator::Reset(const FAnselAccumulationSettings& InSettings)
+{
+	Settings = InSettings;
+	Size = FIntPoint::ZeroValue;
+	NumTiles = FIntPoint::ZeroValue;
+	NumSamples = 0;
+	Noise = MAX_flt;
+	Allocator.Reset(0, Settings);
+	TileNoise.Empty();
+	Sum.Empty();
+	LumaStats.Empty();
+}
+
+void FAnselFrameAccumulator::AddSample(const FColor* Pixels, FIntPoint SampleSize)
+{
+	ANSEL_TRACE_SCOPE(FAnselFrameAccumulator::AddSample);
+
+	if (NumSamples == 0)
+	{
+		Size = SampleSize;
+		NumTiles = FIntPoint(FMath::DivideAndRoundUp(Size.X, TileSize), FMath::DivideAndRoundUp(Size.Y, TileSize));
+		Allocator.Reset(NumTiles.X * NumTiles.Y, Settings);
+		TileNoise.Init(MAX_flt, NumTiles.X * NumTiles.Y);
+		Sum.SetNumZeroed(Size.X * Size.Y);
+		LumaStats.SetNumZeroed(Size.X * Size.Y);
+	}
+	else if (SampleSize != Size)
+	{
+		UE_LOG(LogAnselAccumulation, Warning, TEXT("Ignoring a %dx%d sample of a %dx%d accumulation"), SampleSize.X, SampleSize.Y, Size.X, Size.Y);
+		return;
+	}
+	if (Sum.Num() == 0)
+	{
+		return;
+	}
+	++NumSamples;
+
+	// a row of tiles per task; the whole frame was rendered, so converged tiles are averaged too
+	const int32 Samples = NumSamples;
+	const bool bClampFireflies = Settings.FireflyClamp > 0.f && Samples > MinSamplesForNoise;
+	ParallelFor(NumTiles.Y, [&](int32 TileY)
+	{
+		for (int32 TileX = 0; TileX < NumTiles.X; ++TileX)
+		{
+			const int32 Tile = TileY * NumTiles.X + TileX;
+			const int32 EndX = FMath::Min((TileX + 1) * TileSize, Size.X);
+			const int32 EndY = FMath::Min((TileY + 1) * TileSize, Size.Y);
+			double NoiseSum = 0.;
+			for (int32 Y = TileY * TileSize; Y < EndY; ++Y)
+			{
+				for (int32 Index = Y * Size.X + TileX * TileSize; Index < Y * Size.X + EndX; ++Index)
+				{
+					FLinearColor Linear = FLinearColor::FromSRGBColor(Pixels[Index]);
+					float Luma = GetLuma(Pixels[Index]);
+					FVector2f& Stats = LumaStats[Index];
+
+					if (bClampFireflies)
+					{
+						const float Limit = Stats.X + Settings.FireflyClamp * FMath::Sqrt(Stats.Y / float(Samples - 2)) + 1.f;
+						if (Luma > Limit)
+						{
+							// the limit is in sRGB levels, so the scale is taken back to linear with the 2.2 power
+							const float Scale = FMath::Pow(Limit / Luma, 2.2f);
+							Linear.R *= Scale;
+							Linear.G *= Scale;
+							Linear.B *= Scale;
+							Luma = Limit;
+						}
+					}
+
+					// Welford's running variance
+					const float Delta = Luma - Stats.X;
+					Stats.X += Delta / float(Samples);
+					Stats.Y += Delta * (Luma - Stats.X);
+
+					VectorStore(VectorAdd(VectorLoad(&Sum[Index].R), VectorLoad(&Linear.R)), &Sum[Index].R);
+
+					if (Samples >= MinSamplesForNoise)
+					{
+						NoiseSum += FMath::Sqrt(Stats.Y / (float(Samples - 1) * float(Samples)));
+					}
+				}
+			}
+
+			if (Samples >= MinSamplesForNoise)
+			{
+				TileNoise[Tile] = float(NoiseSum / ((EndX - TileX * TileSize) * (EndY - TileY * TileSize)));
+			}
+		}
+	});
+
+	Allocator.AddSample(TileNoise);
+
+	if (NumSamples >= MinSamplesForNoise)
+	{
+		double NoiseSum = 0.;
+		for (int32 Tile = 0; Tile < TileNoise.Num(); ++Tile)
+		{
+			NoiseSum += TileNoise[Tile];
+		}
+		Noise = float(NoiseSum / TileNoise.Num());
+	}
+}
+
+bool FAnselFrameAccumulator::IsConverged() const
+{
+	return NumSamples > 0 && Allocator.IsFinished();
+}
+
+void FAnselFrameAccumulator::Resolve(TArray<FColor>& OutPixels) const
+{
+	ANSEL_TRACE_SCOPE(FAnselFrameAccumulator::Resolve);
+
+	OutPixels.SetNumUninitialized(Sum.Num());
+	if (NumSamples == 0)
+	{
+		return;
+	}
+
+	const VectorRegister4Float InvNumSamples = VectorSetFloat1(1.f / float(NumSamples));
+	ParallelFor(NumTiles.Y, [&](int32 TileY)
+	{
+		for (int32 TileX = 0; TileX < NumTiles.X; ++TileX)
+		{
+			const int32 EndX = FMath::Min((TileX + 1) * TileSize, Size.X);
+			const int32 EndY = FMath::Min((TileY + 1) * TileSize, Size.Y);
+			for (int32 Y = TileY * TileSize; Y < EndY; ++Y)
+			{
+				for (int32 Index = Y * Size.X + TileX * TileSize; Index < Y * Size.X + EndX; ++Index)
+				{
+					FLinearColor Average;
+					VectorStore(VectorMultiply(VectorLoad(&Sum[Index].R), InvNumSamples), &Average.R);
+					OutPixels[Index] = Average.ToFColorSRGB();
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,95 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** How many frames a capture may average, and when it may stop early */
+struct FAnselAccumulationSettings
+{
+	int32 MaxSamples = 1;
+	float NoiseTarget = 0.f; // standard error of the mean luma, in 8-bit levels; zero takes every sample
+	float FireflyClamp = 0.f; // how many standard deviations above its running mean a pixel's luma may reach; zero doesn't clamp
+};
+
+/** What an accumulation cost, against always rendering the maximum number of frames */
+struct FAnselAccumulationStats
+{
+	int32 NumSamples = 0; // frames rendered
+	int32 NumFixedSamples = 0; // frames MaxSamples would have rendered
+};
+
+/**
+ * Decides when an accumulation can stop rendering, from nothing but each tile's noise after each sample,
+ * so the policy can be driven by made-up noise maps as well as by real frames.  A tile is done once its
+ * noise is down to the target; sky gets there after a couple of samples while foliage goes on, and frames
+ * stop once every tile is done.  Each frame is rendered whole, so every tile is in every sample.
+ */
+class FAnselTileSampleAllocator
+{
+public:
+	void Reset(int32 InNumTiles, const FAnselAccumulationSettings& InSettings);
+
+	/** Records the noise of every tile after another sample */
+	void AddSample(TArrayView<const float> TileNoise);
+
+	bool IsTileActive(int32 Tile) const { return TileSamples.IsValidIndex(Tile) && !bTileConverged[Tile]; }
+
+	/** The samples the tile took to get down to the target, or all of them so far if it hasn't */
+	int32 GetTileSamples(int32 Tile) const { return TileSamples[Tile]; }
+
+	/** Whether every tile is clean enough, or the samples are used up */
+	bool IsFinished() const;
+
+	FAnselAccumulationStats GetStats() const;
+
+private:
+	FAnselAccumulationSettings Settings;
+	int32 NumSamples = 0;
+	int32 NumActiveTiles = 0;
+	TArray<int32> TileSamples;
+	TBitArray<> bTileConverged;
+};
+
+/**
+ * Averages repeated renders of the same view, each with the engine's next sub-pixel jitter and sampling
+ * seeds, into one less noisy image.  Tracks each pixel's running luma variance as it goes, and stops
+ * once FAnselTileSampleAllocator says every tile is clean; every frame rendered goes into the average.
+ */
+class FAnselFrameAccumulator
+{
+public:
+	/** The memory the accumulation buffers of an image this size take */
+	static uint64 GetMemoryRequired(FIntPoint Size);
+
+	void Reset(const FAnselAccumulationSettings& InSettings);
+
+	/** Adds an 8-bit sRGB frame; the first one sets the size, and frames of any other size are ignored */
+	void AddSample(const FColor* Pixels, FIntPoint SampleSize);
+
+	/** Whether every tile is clean enough, or the samples are used up */
+	bool IsConverged() const;
+
+	/** The average so far, as 8-bit sRGB */
+	void Resolve(TArray<FColor>& OutPixels) const;
+
+	int32 GetNumSamples() const { return NumSamples; }
+	FIntPoint GetSize() const { return Size; }
+	FAnselAccumulationStats GetStats() const { return Allocator.GetStats(); }
+
+	/** The mean standard error of the average's luma, in 8-bit levels; unknown, so huge, before two samples */
+	float GetNoise() const { return Noise; }
+
+private:
+	FAnselAccumulationSettings Settings;
+	FIntPoint Size = FIntPoint::ZeroValue;
+	FIntPoint NumTiles = FIntPoint::ZeroValue;
+	int32 NumSamples = 0;
+	float Noise = MAX_flt;
+
+	FAnselTileSampleAllocator Allocator;
+	TArray<float> TileNoise;
+
+	TArray<FLinearColor> Sum; // linear colour
+	TArray<FVector2f> LumaStats; // running mean and sum of squared deviations of each pixel's luma
+};
@@ -0,0 +1,1030 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselBatchCapture.h"
+
+#include "AnselSessionEvents.h"
+#include "AnselBatchShards.h"
+#include "AnselStats.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Misc/CommandLine.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformMisc.h"
+#include "Misc/App.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogAnselBatch, Log, All);
+
+// give up on a host which isn't ready after this long, e.g. because there's no working Ansel SDK or driver;
+// generous, as it includes loading the map
+static const double HostReadyTimeoutSeconds = 300.;
+
+// give up on a session which hasn't started after this long, e.g. because photography is disallowed
+static const double SessionStartTimeoutSeconds = 30.;
+
+// a worker which keeps dying is given up on after this many launches
+static const int32 MaxWorkerLaunches = 3;
+
+// looking for a shot which has come free reads every claim under the system-wide lock, and claims only
+// come free as heartbeats go stale, so there's no point looking more often than workers heartbeat
+static const double ClaimableShotsCheckIntervalSeconds = 1.;
+
+// beyond this even a modest shot outgrows the largest render target the RHI allows
+static const int32 MaxSupersample = 8;
+
+// the largest 2D texture any RHI allows; a shot bigger than this can never be captured, whatever the machine
+static const int32 MaxCaptureDimension = 16384;
+
+static bool ReadJsonVector(const TSharedPtr<FJsonObject>& Object, const TCHAR* Field, int32 NumComponents, double* OutComponents)
+{
+	const TArray<TSharedPtr<FJsonValue>>* Values = nullptr;
+	if (!Object->TryGetArrayField(Field, Values))
+	{
+		return false;
+	}
+	if (Values->Num() != NumComponents)
+	{
+		return false;
+	}
+	for (int32 Index = 0; Index < NumComponents; ++Index)
+	{
+		OutComponents[Index] = (*Values)[Index]->AsNumber();
+	}
+	return true;
+}
+
+bool FAnselBatchManifest::Parse(const FString& JsonText, FAnselBatchManifest& OutManifest, FString& OutError)
+{
+	TSharedPtr<FJsonObject> Root;
+	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonText);
+	if (!FJsonSerializer::Deserialize(Reader, Root) || !Root.IsValid())
+	{
+		OutError = FString::Printf(TEXT("not valid JSON (%s)"), *Reader->GetErrorMessage());
+		return false;
+	}
+
+	OutManifest = FAnselBatchManifest();
+	Root->TryGetStringField(TEXT("OutputDirectory"), OutManifest.OutputDirectory);
+	Root->TryGetNumberField(TEXT("FrameRate"), OutManifest.FrameRate);
+	Root->TryGetNumberField(TEXT("Seed"), OutManifest.Seed);
+	if (OutManifest.FrameRate < 0.)
+	{
+		OutError = TEXT("FrameRate can't be negative");
+		return false;
+	}
+
+	const TSharedPtr<FJsonObject>* SinkObject = nullptr;
+	if (Root->TryGetObjectField(TEXT("FrameSink"), SinkObject))
+	{
+		const TSharedPtr<FJsonObject>& SinkJson = *SinkObject;
+		FAnselBatchFrameSink& Sink = OutManifest.FrameSink;
+		if (!SinkJson->TryGetStringField(TEXT("Name"), Sink.Name) || Sink.Name.IsEmpty())
+		{
+			OutError = TEXT("FrameSink needs a Name");
+			return false;
+		}
+		SinkJson->TryGetNumberField(TEXT("Slots"), Sink.NumSlots);
+		SinkJson->TryGetNumberField(TEXT("StallTimeout"), Sink.StallTimeoutSeconds);
+
+		double Components[2];
+		if (ReadJsonVector(SinkJson, TEXT("MaxResolution"), 2, Components))
+		{
+			Sink.MaxResolution = FIntPoint(int32(Components[0]), int32(Components[1]));
+		}
+
+		FString Policy;
+		if (SinkJson->TryGetStringField(TEXT("Policy"), Policy))
+		{
+			if (Policy.Equals(TEXT("Drop"), ESearchCase::IgnoreCase))
+			{
+				Sink.Policy = EAnselFrameRingPolicy::Drop;
+			}
+			else if (!Policy.Equals(TEXT("Stall"), ESearchCase::IgnoreCase))
+			{
+				OutError = FString::Printf(TEXT("unknown FrameSink Policy '%s'"), *Policy);
+				return false;
+			}
+		}
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* ShotValues = nullptr;
+	if (!Root->TryGetArrayField(TEXT("Shots"), ShotValues) || ShotValues->Num() == 0)
+	{
+		OutError = TEXT("no Shots");
+		return false;
+	}
+
+	for (int32 ShotIndex = 0; ShotIndex < ShotValues->Num(); ++ShotIndex)
+	{
+		const TSharedPtr<FJsonObject>* ShotObject = nullptr;
+		if (!(*ShotValues)[ShotIndex]->TryGetObject(ShotObject))
+		{
+			OutError = FString::Printf(TEXT("shot %d is not an object"), ShotIndex);
+			return false;
+		}
+		const TSharedPtr<FJsonObject>& ShotJson = *ShotObject;
+
+		FAnselBatchShot& Shot = OutManifest.Shots.AddDefaulted_GetRef();
+		Shot.Index = ShotIndex;
+		Shot.SequenceSeconds = OutManifest.FrameRate > 0. ? double(ShotIndex) / OutManifest.FrameRate : 0.;
+		if (!ShotJson->TryGetStringField(TEXT("Name"), Shot.Name))
+		{
+			Shot.Name = FString::Printf(TEXT("Shot%03d"), ShotIndex);
+		}
+
+		double Components[3];
+		if (!ReadJsonVector(ShotJson, TEXT("Location"), 3, Components))
+		{
+			OutError = FString::Printf(TEXT("shot '%s' needs a Location of [X, Y, Z]"), *Shot.Name);
+			return false;
+		}
+		Shot.Location = FVector(Components[0], Components[1], Components[2]);
+
+		if (ReadJsonVector(ShotJson, TEXT("Rotation"), 3, Components))
+		{
+			Shot.Rotation = FRotator(Components[0], Components[1], Components[2]); // pitch, yaw, roll
+		}
+
+		double FOV;
+		if (ShotJson->TryGetNumberField(TEXT("FOV"), FOV))
+		{
+			Shot.FOV = float(FOV);
+		}
+
+		FString CaptureType;
+		if (ShotJson->TryGetStringField(TEXT("CaptureType"), CaptureType))
+		{
+			const UEnum* CaptureTypeEnum = StaticEnum<EAnselCaptureType>();
+			const int64 Value = CaptureTypeEnum->GetValueByNameString(CaptureType);
+			if (Value == INDEX_NONE)
+			{
+				OutError = FString::Printf(TEXT("shot '%s' has unknown CaptureType '%s'"), *Shot.Name, *CaptureType);
+				return false;
+			}
+			Shot.CaptureType = EAnselCaptureType(Value);
+		}
+
+		if (ReadJsonVector(ShotJson, TEXT("Resolution"), 2, Components))
+		{
+			Shot.Resolution = FIntPoint(int32(Components[0]), int32(Components[1]));
+			if (Shot.Resolution.X < 0 || Shot.Resolution.Y < 0 || Shot.Resolution.GetMax() > MaxCaptureDimension)
+			{
+				OutError = FString::Printf(TEXT("shot '%s' has a Resolution of %dx%d, which must be up to %d on each axis"), *Shot.Name, Shot.Resolution.X, Shot.Resolution.Y, MaxCaptureDimension);
+				return false;
+			}
+		}
+
+		FString Quality;
+		if (ShotJson->TryGetStringField(TEXT("Quality"), Quality))
+		{
+			Shot.bHighQuality = Quality.Equals(TEXT("High"), ESearchCase::IgnoreCase);
+		}
+
+		FString Format;
+		if (ShotJson->TryGetStringField(TEXT("Format"), Format))
+		{
+			Shot.bHDR = Format.Equals(TEXT("EXR"), ESearchCase::IgnoreCase);
+			if (!Shot.bHDR && !Format.Equals(TEXT("PNG"), ESearchCase::IgnoreCase))
+			{
+				OutError = FString::Printf(TEXT("shot '%s' has unknown Format '%s'"), *Shot.Name, *Format);
+				return false;
+			}
+			if (Shot.bHDR && !OutManifest.FrameSink.Name.IsEmpty())
+			{
+				OutError = FString::Printf(TEXT("shot '%s' is EXR, which the FrameSink can't carry"), *Shot.Name);
+				return false;
+			}
+		}
+
+		ShotJson->TryGetNumberField(TEXT("Supersample"), Shot.Supersample);
+		if (Shot.Supersample < 1 || Shot.Supersample > MaxSupersample)
+		{
+			OutError = FString::Printf(TEXT("shot '%s' has a Supersample of %d, which must be 1 to %d"), *Shot.Name, Shot.Supersample, MaxSupersample);
+			return false;
+		}
+		if (Shot.Supersample > 1 && Shot.bHDR)
+		{
+			OutError = FString::Printf(TEXT("shot '%s' can't be both EXR and supersampled"), *Shot.Name);
+			return false;
+		}
+
+		FAnselAccumulationSettings& Accumulation = Shot.Accumulation;
+		ShotJson->TryGetNumberField(TEXT("Samples"), Accumulation.MaxSamples);
+		ShotJson->TryGetNumberField(TEXT("NoiseTarget"), Accumulation.NoiseTarget);
+		ShotJson->TryGetNumberField(TEXT("FireflyClamp"), Accumulation.FireflyClamp);
+		if (Accumulation.MaxSamples < 1 || Accumulation.NoiseTarget < 0.f || Accumulation.FireflyClamp < 0.f)
+		{
+			OutError = FString::Printf(TEXT("shot '%s' needs at least 1 Samples, and a NoiseTarget and FireflyClamp of at least 0"), *Shot.Name);
+			return false;
+		}
+		if (Accumulation.MaxSamples > 1 && Shot.bHDR)
+		{
+			OutError = FString::Printf(TEXT("shot '%s' can't be both EXR and accumulated"), *Shot.Name);
+			return false;
+		}
+
+		ShotJson->TryGetNumberField(TEXT("SettleFrames"), Shot.SettleFrames);
+
+		OutManifest.FrameSink.MaxResolution = OutManifest.FrameSink.MaxResolution.ComponentMax(Shot.Resolution);
+	}
+
+	if (!OutManifest.FrameSink.Name.IsEmpty() && (OutManifest.FrameSink.MaxResolution.X <= 0 || OutManifest.FrameSink.MaxResolution.Y <= 0))
+	{
+		OutError = TEXT("FrameSink needs a MaxResolution, or every shot a Resolution");
+		return false;
+	}
+
+	return true;
+}
+
+FAnselBatchScheduler::FAnselBatchScheduler(const FAnselBatchManifest& InManifest, IAnselBatchHost& InHost, FAnselBatchShardQueue* InShardQueue)
+	: Manifest(InManifest)
+	, Host(InHost)
+	, ShardQueue(InShardQueue)
+{
+	Results.SetNum(Manifest.Shots.Num());
+	BatchStartTime = Host.GetTimeSeconds();
+	StageStartTime = BatchStartTime;
+}
+
+void FAnselBatchScheduler::Tick()
+{
+	const double Now = Host.GetTimeSeconds();
+
+	if (ShardQueue && State != EState::Finished)
+	{
+		ShardQueue->Heartbeat();
+	}
+
+	if (State != EState::WaitingForHost && State != EState::Finished)
+	{
+		FrameTimes.Add(float(Now - LastTickTime));
+
+		uint64 UsedPhysical = 0;
+		uint64 UsedGPU = 0;
+		Host.GetMemoryUsage(UsedPhysical, UsedGPU);
+		PeakUsedPhysical = FMath::Max(PeakUsedPhysical, UsedPhysical);
+		PeakUsedGPU = FMath::Max(PeakUsedGPU, UsedGPU);
+	}
+	LastTickTime = Now;
+
+	switch (State)
+	{
+	case EState::WaitingForHost:
+		if (Host.IsReady())
+		{
+			BatchStartTime = Now;
+			StageStartTime = Now;
+			State = EState::StartingSession;
+			Host.StartSession();
+		}
+		else if (Now - StageStartTime > HostReadyTimeoutSeconds)
+		{
+			UE_LOG(LogAnselBatch, Error, TEXT("Not ready to capture after %.0fs: photography isn't supported here (is there a working Ansel SDK and driver?) or the map has no player"),
+				HostReadyTimeoutSeconds);
+			FinishBatch(TEXT("HostNotReady"));
+		}
+		break;
+
+	case EState::StartingSession:
+		if (Now - StageStartTime > SessionStartTimeoutSeconds)
+		{
+			UE_LOG(LogAnselBatch, Error, TEXT("Photography session didn't start"));
+			FinishBatch(TEXT("NoSession"));
+		}
+		break;
+
+	case EState::Capturing:
+		if (!Host.IsCaptureInProgress() && !Host.ContinueCapture())
+		{
+			Results[CurrentShot].CaptureSeconds = Now - StageStartTime;
+			Results[CurrentShot].Accumulation = Host.GetCaptureStats();
+			EndShot(Host.WasCaptureDropped() ? TEXT("Dropped") : TEXT("Captured"));
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void FAnselBatchScheduler::HandleSessionStarted()
+{
+	if (State == EState::StartingSession)
+	{
+		SessionStartSeconds = Host.GetTimeSeconds() - StageStartTime;
+		if (Manifest.FrameRate > 0.)
+		{
+			// seeded right before the world is first stepped, so whatever drew on the streams while the map
+			// loaded and the session started can't shift what the sequence's frames get
+			FMath::RandInit(Manifest.Seed);
+			FMath::SRandInit(Manifest.Seed);
+		}
+		BeginNextShot();
+	}
+}
+
+void FAnselBatchScheduler::HandleSessionEnded()
+{
+	if (State != EState::Finished)
+	{
+		UE_LOG(LogAnselBatch, Error, TEXT("Photography session ended before the batch was done"));
+		FinishBatch(TEXT("SessionEnded"));
+	}
+}
+
+void FAnselBatchScheduler::HandleSessionFrame(const FAnselSessionFrame& Frame)
+{
+	if (State != EState::Settling)
+	{
+		return;
+	}
+
+	++ShotFrames;
+
+	// the world moving on unsettles the frame just as the view changing does
+	if (Host.IsSteppingWorld())
+	{
+		SettleFromFrame = ShotFrames;
+		return;
+	}
+
+	// only count settled frames since the shot's view went in, which happens on the shot's first frame
+	const FAnselBatchShot& Shot = Manifest.Shots[CurrentShot];
+	const uint32 SettledFrames = FMath::Min(Frame.FramesSinceViewChanged, ShotFrames - SettleFromFrame);
+	const int32 SettleFrames = Shot.SettleFrames >= 0 ? Shot.SettleFrames : Host.GetDefaultSettleFrames();
+	if (Frame.bCaptureActive || SettledFrames < uint32(SettleFrames))
+	{
+		return;
+	}
+
+	FShotResult& Result = Results[CurrentShot];
+	const double Now = Host.GetTimeSeconds();
+	Result.SettleFrames = ShotFrames;
+	Result.SettleSeconds = Now - StageStartTime;
+	Result.Filename = FPaths::Combine(Manifest.OutputDirectory, Shot.Name + (Shot.bHDR ? TEXT(".exr") : TEXT(".png")));
+
+	StageStartTime = Now;
+	FString OverBudgetReason;
+	if (!Host.CanAffordCapture(Shot, OverBudgetReason))
+	{
+		UE_LOG(LogAnselBatch, Warning, TEXT("Shot '%s': over budget (%s); skipped"), *Shot.Name, *OverBudgetReason);
+		Result.Filename.Reset();
+		EndShot(TEXT("OverBudget"));
+	}
+	else if (Host.StartCapture(Shot, Result.Filename))
+	{
+		State = EState::Capturing;
+		if (!Manifest.FrameSink.Name.IsEmpty())
+		{
+			Result.Filename.Reset(); // went to the frame sink instead
+		}
+	}
+	else
+	{
+		UE_LOG(LogAnselBatch, Warning, TEXT("Shot '%s': capture type %s can't be taken unattended; skipped"), *Shot.Name, *StaticEnum<EAnselCaptureType>()->GetNameStringByValue(int64(Shot.CaptureType)));
+		Result.Filename.Reset();
+		EndShot(TEXT("Unsupported"));
+	}
+}
+
+void FAnselBatchScheduler::BeginNextShot()
+{
+	int32 ShotIndex = INDEX_NONE;
+	if (ShardQueue)
+	{
+		ShotIndex = ShardQueue->ClaimNextShot();
+	}
+	else if (CurrentShot + 1 < Manifest.Shots.Num())
+	{
+		ShotIndex = CurrentShot + 1;
+	}
+
+	if (ShotIndex == INDEX_NONE)
+	{
+		// shots this process never got to were taken by other shards
+		FinishBatch(ShardQueue ? TEXT("OtherShard") : TEXT("NotRun"));
+		Host.StopSession();
+		return;
+	}
+
+	CurrentShot = ShotIndex;
+	ShotFrames = 0;
+	SettleFromFrame = 1;
+	StageStartTime = Host.GetTimeSeconds();
+	State = EState::Settling;
+
+	if (Manifest.FrameRate > 0.)
+	{
+		// the world only goes forwards, so a shot whose time has passed (e.g. one reclaimed from a dead
+		// shard) can't be taken by this process any more
+		const int32 StepsToShot = ShotIndex - WorldSteps;
+		if (StepsToShot < 0 || !Host.StepWorld(StepsToShot))
+		{
+			EndShot(TEXT("NotSteppable"));
+			return;
+		}
+		WorldSteps = ShotIndex;
+	}
+
+	Host.SetShotView(Manifest.Shots[ShotIndex]);
+}
+
+void FAnselBatchScheduler::EndShot(const TCHAR* Status)
+{
+	FShotResult& Result = Results[CurrentShot];
+	Result.Status = Status;
+	UE_LOG(LogAnselBatch, Log, TEXT("Shot '%s': %s (settled in %d frames / %.2fs, captured in %.2fs)"),
+		*Manifest.Shots[CurrentShot].Name, Status, Result.SettleFrames, Result.SettleSeconds, Result.CaptureSeconds);
+
+	if (ShardQueue)
+	{
+		ShardQueue->MarkShotDone(CurrentShot, Status);
+	}
+
+	BeginNextShot();
+}
+
+void FAnselBatchScheduler::FinishBatch(const TCHAR* RemainingStatus)
+{
+	for (FShotResult& Result : Results)
+	{
+		if (Result.Status == TEXT("Pending"))
+		{
+			Result.Status = RemainingStatus;
+		}
+	}
+
+	BatchSeconds = Host.GetTimeSeconds() - BatchStartTime;
+	State = EState::Finished;
+}
+
+FString FAnselBatchScheduler::BuildReport() const
+{
+	FString Report;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Report);
+
+	TArray<float> SortedFrameTimes = FrameTimes;
+	SortedFrameTimes.Sort();
+	auto FrameTimePercentileMs = [&SortedFrameTimes](float Percentile)
+	{
+		return SortedFrameTimes.Num() > 0 ? 1000. * SortedFrameTimes[FMath::Min(int32(Percentile * SortedFrameTimes.Num()), SortedFrameTimes.Num() - 1)] : 0.;
+	};
+
+	Writer->WriteObjectStart();
+	if (ShardQueue)
+	{
+		Writer->WriteValue(TEXT("Shard"), ShardQueue->GetWorkerId());
+	}
+	Writer->WriteValue(TEXT("SessionStartSeconds"), SessionStartSeconds);
+	Writer->WriteValue(TEXT("TotalSeconds"), BatchSeconds);
+	Writer->WriteObjectStart(TEXT("FrameTimeMs"));
+	Writer->WriteValue(TEXT("P50"), FrameTimePercentileMs(0.5f));
+	Writer->WriteValue(TEXT("P90"), FrameTimePercentileMs(0.9f));
+	Writer->WriteValue(TEXT("P99"), FrameTimePercentileMs(0.99f));
+	Writer->WriteValue(TEXT("Max"), FrameTimePercentileMs(1.f));
+	Writer->WriteObjectEnd();
+	Writer->WriteValue(TEXT("NumFrames"), FrameTimes.Num());
+	Writer->WriteValue(TEXT("PeakUsedPhysicalMB"), double(PeakUsedPhysical) / (1024. * 1024.));
+	Writer->WriteValue(TEXT("PeakUsedGPUMB"), double(PeakUsedGPU) / (1024. * 1024.));
+
+	int64 NumSamples = 0;
+	int64 NumFixedSamples = 0;
+	for (const FShotResult& Result : Results)
+	{
+		// only accumulated shots could have saved anything
+		if (Result.Accumulation.NumFixedSamples > 0)
+		{
+			NumSamples += Result.Accumulation.NumSamples;
+			NumFixedSamples += Result.Accumulation.NumFixedSamples;
+		}
+	}
+	Writer->WriteValue(TEXT("AccumulationSavedPercent"), NumFixedSamples > 0 ? 100. * double(NumFixedSamples - NumSamples) / double(NumFixedSamples) : 0.);
+	Writer->WriteArrayStart(TEXT("Shots"));
+	for (int32 ShotIndex = 0; ShotIndex < Manifest.Shots.Num(); ++ShotIndex)
+	{
+		const FShotResult& Result = Results[ShotIndex];
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("Name"), Manifest.Shots[ShotIndex].Name);
+		Writer->WriteValue(TEXT("Status"), Result.Status);
+		Writer->WriteValue(TEXT("Filename"), Result.Filename);
+		Writer->WriteValue(TEXT("SettleFrames"), Result.SettleFrames);
+		Writer->WriteValue(TEXT("SettleSeconds"), Result.SettleSeconds);
+		Writer->WriteValue(TEXT("CaptureSeconds"), Result.CaptureSeconds);
+		Writer->WriteValue(TEXT("NumSamples"), Result.Accumulation.NumSamples);
+		Writer->WriteValue(TEXT("NumFixedSamples"), Result.Accumulation.NumFixedSamples);
+		Writer->WriteObjectEnd();
+	}
+	Writer->WriteArrayEnd();
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	return Report;
+}
+
+// a shard's entry for a shot it never took, or gave up on before getting to, gives way to one from the
+// shard which took it
+static int32 GetShotStatusRank(const FString& Status)
+{
+	if (Status == TEXT("OtherShard") || Status == TEXT("Pending"))
+	{
+		return 0;
+	}
+	if (Status == TEXT("NotRun") || Status == TEXT("HostNotReady") || Status == TEXT("NoSession") || Status == TEXT("SessionEnded"))
+	{
+		return 1;
+	}
+	return 2;
+}
+
+FString FAnselBatchScheduler::MergeReports(const TArray<FString>& Reports)
+{
+	TArray<TSharedPtr<FJsonValue>> Shards;
+	TArray<TSharedPtr<FJsonValue>> Shots;
+	TArray<int32> ShotRanks;
+	TSharedRef<FJsonObject> FrameTimeMs = MakeShared<FJsonObject>();
+	double SessionStartSeconds = 0.;
+	double TotalSeconds = 0.;
+	double NumFrames = 0.;
+	double PeakUsedPhysicalMB = 0.;
+	double PeakUsedGPUMB = 0.;
+
+	for (const FString& Report : Reports)
+	{
+		TSharedPtr<FJsonObject> Root;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Report), Root) || !Root.IsValid())
+		{
+			UE_LOG(LogAnselBatch, Warning, TEXT("Skipping a shard report which isn't valid JSON"));
+			continue;
+		}
+
+		FString Shard;
+		Root->TryGetStringField(TEXT("Shard"), Shard);
+		Shards.Add(MakeShared<FJsonValueString>(Shard));
+
+		SessionStartSeconds = FMath::Max(SessionStartSeconds, Root->GetNumberField(TEXT("SessionStartSeconds")));
+		TotalSeconds = FMath::Max(TotalSeconds, Root->GetNumberField(TEXT("TotalSeconds")));
+		NumFrames += Root->GetNumberField(TEXT("NumFrames"));
+		PeakUsedPhysicalMB += Root->GetNumberField(TEXT("PeakUsedPhysicalMB"));
+		PeakUsedGPUMB += Root->GetNumberField(TEXT("PeakUsedGPUMB"));
+
+		const TSharedPtr<FJsonObject>* ShardFrameTimeMs = nullptr;
+		if (Root->TryGetObjectField(TEXT("FrameTimeMs"), ShardFrameTimeMs))
+		{
+			for (const TPair<FString, TSharedPtr<FJsonValue>>& Percentile : (*ShardFrameTimeMs)->Values)
+			{
+				double Worst = 0.;
+				FrameTimeMs->TryGetNumberField(Percentile.Key, Worst);
+				FrameTimeMs->SetNumberField(Percentile.Key, FMath::Max(Worst, Percentile.Value->AsNumber()));
+			}
+		}
+
+		// every shard lists every shot of the manifest, in its order
+		const TArray<TSharedPtr<FJsonValue>>* ShardShots = nullptr;
+		if (Root->TryGetArrayField(TEXT("Shots"), ShardShots))
+		{
+			for (int32 ShotIndex = 0; ShotIndex < ShardShots->Num(); ++ShotIndex)
+			{
+				if (!Shots.IsValidIndex(ShotIndex))
+				{
+					Shots.Add(MakeShared<FJsonValueObject>(MakeShared<FJsonObject>()));
+					ShotRanks.Add(-1);
+				}
+
+				// a relaunched worker's report comes after the one it wrote before, so a retry wins a tie
+				const TSharedPtr<FJsonObject>* Shot = nullptr;
+				FString Status;
+				if (!(*ShardShots)[ShotIndex]->TryGetObject(Shot) || !(*Shot)->TryGetStringField(TEXT("Status"), Status))
+				{
+					continue;
+				}
+				const int32 Rank = GetShotStatusRank(Status);
+				if (Rank >= ShotRanks[ShotIndex])
+				{
+					(*Shot)->SetStringField(TEXT("Shard"), Shard);
+					Shots[ShotIndex] = (*ShardShots)[ShotIndex];
+					ShotRanks[ShotIndex] = Rank;
+				}
+			}
+		}
+	}
+
+	int64 NumSamples = 0;
+	int64 NumFixedSamples = 0;
+	for (const TSharedPtr<FJsonValue>& Shot : Shots)
+	{
+		double ShotSamples = 0.;
+		double ShotFixedSamples = 0.;
+		Shot->AsObject()->TryGetNumberField(TEXT("NumSamples"), ShotSamples);
+		Shot->AsObject()->TryGetNumberField(TEXT("NumFixedSamples"), ShotFixedSamples);
+		if (ShotFixedSamples > 0.)
+		{
+			NumSamples += int64(ShotSamples);
+			NumFixedSamples += int64(ShotFixedSamples);
+		}
+	}
+
+	TSharedRef<FJsonObject> Merged = MakeShared<FJsonObject>();
+	Merged->SetArrayField(TEXT("Shards"), Shards);
+	Merged->SetNumberField(TEXT("SessionStartSeconds"), SessionStartSeconds);
+	Merged->SetNumberField(TEXT("TotalSeconds"), TotalSeconds);
+	Merged->SetObjectField(TEXT("FrameTimeMs"), FrameTimeMs);
+	Merged->SetNumberField(TEXT("NumFrames"), NumFrames);
+	Merged->SetNumberField(TEXT("PeakUsedPhysicalMB"), PeakUsedPhysicalMB);
+	Merged->SetNumberField(TEXT("PeakUsedGPUMB"), PeakUsedGPUMB);
+	Merged->SetNumberField(TEXT("AccumulationSavedPercent"), NumFixedSamples > 0 ? 100. * double(NumFixedSamples - NumSamples) / double(NumFixedSamples) : 0.);
+	Merged->SetArrayField(TEXT("Shots"), Shots);
+
+	FString MergedReport;
+	FJsonSerializer::Serialize(Merged, TJsonWriterFactory<>::Create(&MergedReport));
+	return MergedReport;
+}
+
+// lower is better for every figure in a report, apart from the counts and the savings
+static void GatherReportMetrics(const FJsonObject& Object, const FString& Prefix, TMap<FString, double>& OutMetrics)
+{
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Field : Object.Values)
+	{
+		const FString Name = Prefix + Field.Key;
+		double Number;
+		const TSharedPtr<FJsonObject>* Child = nullptr;
+		const TArray<TSharedPtr<FJsonValue>>* Shots = nullptr;
+		if (Field.Key.StartsWith(TEXT("Num")) || Field.Key == TEXT("SettleFrames") || Field.Key.EndsWith(TEXT("SavedPercent")))
+		{
+			continue;
+		}
+		else if (Field.Value->TryGetNumber(Number))
+		{
+			OutMetrics.Add(Name, Number);
+		}
+		else if (Field.Value->TryGetObject(Child))
+		{
+			GatherReportMetrics(**Child, Name + TEXT("."), OutMetrics);
+		}
+		else if (Field.Key == TEXT("Shots") && Field.Value->TryGetArray(Shots))
+		{
+			// shots are matched up by name, so reordering a manifest doesn't spoil the comparison
+			for (const TSharedPtr<FJsonValue>& ShotValue : *Shots)
+			{
+				const TSharedPtr<FJsonObject>* Shot = nullptr;
+				FString ShotName;
+				if (ShotValue->TryGetObject(Shot) && (*Shot)->TryGetStringField(TEXT("Name"), ShotName))
+				{
+					GatherReportMetrics(**Shot, Name + TEXT(".") + ShotName + TEXT("."), OutMetrics);
+				}
+			}
+		}
+	}
+}
+
+TArray<TSharedPtr<FJsonValue>> FAnselBatchScheduler::FindRegressions(const FJsonObject& Baseline, const FJsonObject& Current, double ThresholdPercent)
+{
+	TMap<FString, double> BaselineMetrics;
+	TMap<FString, double> CurrentMetrics;
+	GatherReportMetrics(Baseline, FString(), BaselineMetrics);
+	GatherReportMetrics(Current, FString(), CurrentMetrics);
+
+	TArray<TSharedPtr<FJsonValue>> Regressions;
+	for (const TPair<FString, double>& Metric : CurrentMetrics)
+	{
+		const double* BaselineValue = BaselineMetrics.Find(Metric.Key);
+		if (!BaselineValue || *BaselineValue <= 0.)
+		{
+			continue;
+		}
+
+		const double ChangePercent = 100. * (Metric.Value - *BaselineValue) / *BaselineValue;
+		if (ChangePercent > ThresholdPercent)
+		{
+			TSharedRef<FJsonObject> Regression = MakeShared<FJsonObject>();
+			Regression->SetStringField(TEXT("Metric"), Metric.Key);
+			Regression->SetNumberField(TEXT("Baseline"), *BaselineValue);
+			Regression->SetNumberField(TEXT("Current"), Metric.Value);
+			Regression->SetNumberField(TEXT("ChangePercent"), ChangePercent);
+			Regressions.Add(MakeShared<FJsonValueObject>(Regression));
+		}
+	}
+	return Regressions;
+}
+
+TUniquePtr<FAnselBatchRunner> FAnselBatchRunner::CreateFromCommandLine(FAnselSessionEvents& SessionEvents, TUniquePtr<IAnselBatchHost> Host)
+{
+	FString ManifestFilename;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("-AnselBatch="), ManifestFilename))
+	{
+		return nullptr;
+	}
+
+	FString JsonText;
+	if (!FFileHelper::LoadFileToString(JsonText, *ManifestFilename))
+	{
+		UE_LOG(LogAnselBatch, Error, TEXT("Couldn't read batch manifest %s"), *ManifestFilename);
+		return nullptr;
+	}
+
+	FAnselBatchManifest Manifest;
+	FString Error;
+	if (!FAnselBatchManifest::Parse(JsonText, Manifest, Error))
+	{
+		UE_LOG(LogAnselBatch, Error, TEXT("Batch manifest %s: %s"), *ManifestFilename, *Error);
+		return nullptr;
+	}
+
+	if (Manifest.OutputDirectory.IsEmpty())
+	{
+		Manifest.OutputDirectory = FPaths::Combine(FPaths::ScreenShotDir(), TEXT("AnselBatch"));
+	}
+	UE_LOG(LogAnselBatch, Log, TEXT("Running %d shots from %s into %s"), Manifest.Shots.Num(), *ManifestFilename, *Manifest.OutputDirectory);
+
+	const FString ClaimDirectory = FPaths::Combine(Manifest.OutputDirectory, TEXT("Claims"));
+	int32 NumShards = 1;
+	FString WorkerId;
+	FParse::Value(FCommandLine::Get(), TEXT("-AnselBatchWorkers="), NumShards);
+
+	TUniquePtr<FAnselBatchShardQueue> ShardQueue;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-AnselBatchWorker="), WorkerId))
+	{
+		ShardQueue = MakeUnique<FAnselBatchShardQueue>(ClaimDirectory, WorkerId, Manifest.Shots.Num());
+	}
+	else if (NumShards > 1)
+	{
+		ShardQueue = MakeUnique<FAnselBatchShardQueue>(ClaimDirectory, TEXT("0"), Manifest.Shots.Num());
+		ShardQueue->ResetClaims();
+
+		// the merged report is made from whatever shard reports are there, so none may be left from an earlier run
+		TArray<FString> OldReports;
+		IFileManager::Get().FindFiles(OldReports, *FPaths::Combine(Manifest.OutputDirectory, TEXT("AnselBatchReport_*.json")), true, false);
+		for (const FString& OldReport : OldReports)
+		{
+			IFileManager::Get().Delete(*FPaths::Combine(Manifest.OutputDirectory, OldReport));
+		}
+	}
+
+	TUniquePtr<FAnselFrameRing> FrameSink;
+	const FAnselBatchFrameSink& SinkSettings = Manifest.FrameSink;
+	if (!SinkSettings.Name.IsEmpty())
+	{
+		// one ring per shard, as each ring has a single writer
+		const FString SinkName = ShardQueue.IsValid() ? FString::Printf(TEXT("%s_%s"), *SinkSettings.Name, *ShardQueue->GetWorkerId()) : SinkSettings.Name;
+		FrameSink = FAnselFrameRing::Create(SinkName, SinkSettings.NumSlots, SinkSettings.MaxResolution, SinkSettings.Policy, SinkSettings.StallTimeoutSeconds);
+		if (!FrameSink.IsValid())
+		{
+			return nullptr;
+		}
+	}
+
+	TUniquePtr<FAnselBatchRunner> Runner = MakeUnique<FAnselBatchRunner>(Manifest, SessionEvents, MoveTemp(Host), MoveTemp(ShardQueue), MoveTemp(FrameSink));
+	if (WorkerId.IsEmpty() && NumShards > 1)
+	{
+		Runner->LaunchWorkers(NumShards - 1);
+	}
+	return Runner;
+}
+
+FAnselBatchRunner::FAnselBatchRunner(const FAnselBatchManifest& Manifest, FAnselSessionEvents& InSessionEvents, TUniquePtr<IAnselBatchHost> InHost, TUniquePtr<FAnselBatchShardQueue> InShardQueue, TUniquePtr<FAnselFrameRing> InFrameSink)
+	: SessionEvents(InSessionEvents)
+	, Host(MoveTemp(InHost))
+	, ShardQueue(MoveTemp(InShardQueue))
+	, FrameSink(MoveTemp(InFrameSink))
+	, Scheduler(Manifest, *Host, ShardQueue.Get())
+	, OutputDirectory(Manifest.OutputDirectory)
+	, ReportFilename(FPaths::Combine(Manifest.OutputDirectory, TEXT("AnselBatchReport.json")))
+{
+	Host->SetFrameSink(FrameSink.Get());
+
+	if (ShardQueue.IsValid())
+	{
+		// a relaunched worker keeps the report of the shots it took before it fell over
+		int32 Launch = 1;
+		FParse::Value(FCommandLine::Get(), TEXT("-AnselBatchWorkerLaunch="), Launch);
+		ReportFilename = FPaths::Combine(OutputDirectory, Launch > 1
+			? FString::Printf(TEXT("AnselBatchReport_%s_%d.json"), *ShardQueue->GetWorkerId(), Launch)
+			: FString::Printf(TEXT("AnselBatchReport_%s.json"), *ShardQueue->GetWorkerId()));
+	}
+
+	FParse::Value(FCommandLine::Get(), TEXT("-AnselBatchBaseline="), BaselineFilename);
+	FParse::Value(FCommandLine::Get(), TEXT("-AnselBatchThreshold="), RegressionThresholdPercent);
+
+	if (Manifest.FrameRate > 0.)
+	{
+		// every tick advances the world by exactly one output frame, however long it takes to render
+		bRestoreFixedTimeStep = true;
+		bWasUsingFixedTimeStep = FApp::UseFixedTimeStep();
+		FixedDeltaTimeBefore = FApp::GetFixedDeltaTime();
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(1. / Manifest.FrameRate);
+	}
+
+	SessionStartedHandle = SessionEvents.OnSessionStarted.AddRaw(&Scheduler, &FAnselBatchScheduler::HandleSessionStarted);
+	SessionEndedHandle = SessionEvents.OnSessionEnded.AddRaw(&Scheduler, &FAnselBatchScheduler::HandleSessionEnded);
+	SessionFrameHandle = SessionEvents.OnSessionFrame.AddRaw(&Scheduler, &FAnselBatchScheduler::HandleSessionFrame);
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FAnselBatchRunner::Tick));
+}
+
+FAnselBatchRunner::~FAnselBatchRunner()
+{
+	SessionEvents.OnSessionStarted.Remove(SessionStartedHandle);
+	SessionEvents.OnSessionEnded.Remove(SessionEndedHandle);
+	SessionEvents.OnSessionFrame.Remove(SessionFrameHandle);
+	if (TickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	}
+	for (FWorkerProcess& Worker : Workers)
+	{
+		FPlatformProcess::CloseProc(Worker.Handle);
+	}
+	Host->SetFrameSink(nullptr);
+
+	if (bRestoreFixedTimeStep)
+	{
+		FApp::SetUseFixedTimeStep(bWasUsingFixedTimeStep);
+		FApp::SetFixedDeltaTime(FixedDeltaTimeBefore);
+	}
+}
+
+void FAnselBatchRunner::LaunchWorkers(int32 NumWorkers)
+{
+	for (int32 WorkerIndex = 1; WorkerIndex <= NumWorkers; ++WorkerIndex)
+	{
+		FWorkerProcess& Worker = Workers.AddDefaulted_GetRef();
+		Worker.WorkerId = FString::FromInt(WorkerIndex);
+		LaunchWorker(Worker);
+	}
+}
+
+void FAnselBatchRunner::LaunchWorker(FWorkerProcess& Worker)
+{
+	// same command line, minus the request to coordinate
+	FString Params = FCommandLine::GetOriginal();
+	FString NumShardsParam;
+	if (FParse::Value(*Params, TEXT("-AnselBatchWorkers="), NumShardsParam))
+	{
+		Params.ReplaceInline(*FString::Printf(TEXT("-AnselBatchWorkers=%s"), *NumShardsParam), TEXT(""));
+	}
+	++Worker.NumLaunches;
+	Params += FString::Printf(TEXT(" -AnselBatchWorker=%s -AnselBatchWorkerLaunch=%d"), *Worker.WorkerId, Worker.NumLaunches);
+
+	FPlatformProcess::CloseProc(Worker.Handle);
+	Worker.Handle = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Params, true, false, false, nullptr, 0, nullptr, nullptr);
+
+	UE_LOG(LogAnselBatch, Log, TEXT("Launched batch worker %s (attempt %d)"), *Worker.WorkerId, Worker.NumLaunches);
+}
+
+bool FAnselBatchRunner::TickWorkers()
+{
+	bool bAnyRunning = false;
+	TOptional<bool> bHasClaimableShots;
+	for (FWorkerProcess& Worker : Workers)
+	{
+		bool bRelaunch = false;
+		if (Worker.Handle.IsValid())
+		{
+			if (FPlatformProcess::IsProcRunning(Worker.Handle))
+			{
+				bAnyRunning = true;
+				continue;
+			}
+
+			int32 ReturnCode = 0;
+			FPlatformProcess::GetProcReturnCode(Worker.Handle, &ReturnCode);
+			FPlatformProcess::CloseProc(Worker.Handle);
+			Worker.Handle = FProcHandle();
+
+			// one which fell over is relaunched under the same id, which takes its claims straight back
+			// rather than waiting for its heartbeat to go stale
+			if (ReturnCode != 0)
+			{
+				UE_LOG(LogAnselBatch, Warning, TEXT("Batch worker %s exited with code %d"), *Worker.WorkerId, ReturnCode);
+				bRelaunch = ShardQueue->HasUnfinishedShots();
+			}
+		}
+
+		// a worker which finished cleanly found nothing left to claim, so it's only wanted again if a
+		// shot has since come free, e.g. from another worker which hung
+		if (!bRelaunch && Worker.NumLaunches < MaxWorkerLaunches)
+		{
+			if (!bHasClaimableShots.IsSet())
+			{
+				bHasClaimableShots = false;
+				const double Now = FPlatformTime::Seconds();
+				if (Now - LastClaimableShotsCheckTime >= ClaimableShotsCheckIntervalSeconds)
+				{
+					LastClaimableShotsCheckTime = Now;
+					bHasClaimableShots = ShardQueue->HasClaimableShots();
+				}
+			}
+			bRelaunch = bHasClaimableShots.GetValue();
+		}
+
+		if (bRelaunch && Worker.NumLaunches < MaxWorkerLaunches)
+		{
+			LaunchWorker(Worker);
+			bAnyRunning = true;
+		}
+	}
+	return bAnyRunning;
+}
+
+void FAnselBatchRunner::WriteMergedReport()
+{
+	// sorted, so a relaunched worker's report comes after the one it wrote before
+	TArray<FString> ShardReportFilenames;
+	IFileManager::Get().FindFiles(ShardReportFilenames, *FPaths::Combine(OutputDirectory, TEXT("AnselBatchReport_*.json")), true, false);
+	ShardReportFilenames.Sort();
+
+	TArray<FString> ShardReports;
+	for (const FString& ShardReportFilename : ShardReportFilenames)
+	{
+		if (!FFileHelper::LoadFileToString(ShardReports.AddDefaulted_GetRef(), *FPaths::Combine(OutputDirectory, ShardReportFilename)))
+		{
+			UE_LOG(LogAnselBatch, Warning, TEXT("Couldn't read shard report %s"), *ShardReportFilename);
+			ShardReports.Pop();
+		}
+	}
+
+	FString Report = FAnselBatchScheduler::MergeReports(ShardReports);
+	if (!BaselineFilename.IsEmpty())
+	{
+		Report = CompareWithBaseline(Report);
+	}
+
+	const FString MergedReportFilename = FPaths::Combine(OutputDirectory, TEXT("AnselBatchReport.json"));
+	FFileHelper::SaveStringToFile(Report, *MergedReportFilename);
+	UE_LOG(LogAnselBatch, Log, TEXT("Merged %d shard reports into %s"), ShardReports.Num(), *MergedReportFilename);
+}
+
+FString FAnselBatchRunner::CompareWithBaseline(const FString& Report)
+{
+	FString BaselineText;
+	TSharedPtr<FJsonObject> Baseline;
+	TSharedPtr<FJsonObject> Current;
+	if (!FFileHelper::LoadFileToString(BaselineText, *BaselineFilename) ||
+		!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineText), Baseline) || !Baseline.IsValid() ||
+		!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Report), Current) || !Current.IsValid())
+	{
+		UE_LOG(LogAnselBatch, Error, TEXT("Couldn't read baseline report %s"), *BaselineFilename);
+		bRegressed = true;
+		return Report;
+	}
+
+	const TArray<TSharedPtr<FJsonValue>> Regressions = FAnselBatchScheduler::FindRegressions(*Baseline, *Current, RegressionThresholdPercent);
+	for (const TSharedPtr<FJsonValue>& Regression : Regressions)
+	{
+		const TSharedPtr<FJsonObject>& Fields = Regression->AsObject();
+		UE_LOG(LogAnselBatch, Warning, TEXT("Regression: %s went from %.3f to %.3f (+%.1f%%)"), *Fields->GetStringField(TEXT("Metric")),
+			Fields->GetNumberField(TEXT("Baseline")), Fields->GetNumberField(TEXT("Current")), Fields->GetNumberField(TEXT("ChangePercent")));
+	}
+	UE_LOG(LogAnselBatch, Log, TEXT("%d regressions over %.1f%% against %s"), Regressions.Num(), RegressionThresholdPercent, *BaselineFilename);
+	bRegressed = Regressions.Num() > 0;
+
+	Current->SetStringField(TEXT("Baseline"), BaselineFilename);
+	Current->SetNumberField(TEXT("RegressionThresholdPercent"), RegressionThresholdPercent);
+	Current->SetArrayField(TEXT("Regressions"), Regressions);
+
+	FString ComparedReport;
+	FJsonSerializer::Serialize(Current.ToSharedRef(), TJsonWriterFactory<>::Create(&ComparedReport));
+	return ComparedReport;
+}
+
+bool FAnselBatchRunner::Tick(float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(Ansel);
+	Scheduler.Tick();
+	if (!Scheduler.IsFinished())
+	{
+		TickWorkers();
+		return true;
+	}
+
+	if (!bReportWritten)
+	{
+		bReportWritten = true;
+		FString Report = Scheduler.BuildReport();
+
+		// a shard's report is only part of the batch, so only the merged one is held up against the baseline
+		if (!BaselineFilename.IsEmpty() && !ShardQueue.IsValid())
+		{
+			Report = CompareWithBaseline(Report);
+		}
+		FFileHelper::SaveStringToFile(Report, *ReportFilename);
+		UE_LOG(LogAnselBatch, Log, TEXT("Batch done; report written to %s"), *ReportFilename);
+	}
+
+	// the coordinator stays up until its workers are done, to restart any which fall over
+	if (TickWorkers())
+	{
+		return true;
+	}
+	if (Workers.Num() > 0)
+	{
+		WriteMergedReport();
+	}
+
+	TickerHandle.Reset();
+	FPlatformMisc::RequestExitWithStatus(false, bRegressed ? 1 : 0, TEXT("AnselBatch"));
+	return false;
+}
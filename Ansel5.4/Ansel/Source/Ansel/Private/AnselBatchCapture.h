@@ -0,0 +1,277 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "HAL/PlatformProcess.h"
+#include "AnselFunctionLibrary.h"
+#include "AnselFrameSink.h"
+#include "AnselAccumulation.h"
+
+struct FAnselSessionEvents;
+struct FAnselSessionFrame;
+class FJsonObject;
+class FJsonValue;
+class FAnselBatchShardQueue;
+
+/** One still in a batch manifest */
+struct FAnselBatchShot
+{
+	int32 Index = 0; // in the manifest
+	double SequenceSeconds = 0.; // Index / FrameRate, if the manifest has a FrameRate
+	FString Name;
+	FVector Location = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	float FOV = 90.f;
+	EAnselCaptureType CaptureType = EAnselCaptureType::SuperResolution;
+	FIntPoint Resolution = FIntPoint::ZeroValue; // zero means the viewport's own size
+	bool bHighQuality = true;
+	bool bHDR = false; // a linear half-float EXR of the scene colour rather than a tonemapped 8-bit PNG
+	int32 Supersample = 1; // rendered at this multiple of Resolution and filtered down to it
+	FAnselAccumulationSettings Accumulation;
+	int32 SettleFrames = -1; // negative means r.Photography.SettleFrames
+};
+
+/** Where captured frames go instead of image files, if a manifest names one */
+struct FAnselBatchFrameSink
+{
+	FString Name; // of the shared memory region; empty means write image files
+	int32 NumSlots = 4;
+	FIntPoint MaxResolution = FIntPoint::ZeroValue; // zero means the largest shot resolution
+	EAnselFrameRingPolicy Policy = EAnselFrameRingPolicy::Stall;
+	double StallTimeoutSeconds = 0.1; // a few frames; the game thread waits this long for the reader
+};
+
+/**
+ * A list of shots for -AnselBatch=<manifest.json>, e.g.
+ *
+ *   { "OutputDirectory": "Saved/Screenshots/Batch", "FrameRate": 30, "Seed": 1234,
+ *     "FrameSink": { "Name": "AnselFrames", "Slots": 4, "Policy": "Stall", "StallTimeout": 0.1 },
+ *     "Shots": [ { "Name": "Hero", "Location": [0, 0, 200], "Rotation": [-10, 90, 0], "FOV": 60,
+ *                  "CaptureType": "SuperResolution", "Resolution": [7680, 4320], "Quality": "High", "Format": "PNG",
+ *                  "Supersample": 2 } ] }
+ *
+ * FrameSink is optional; see FAnselFrameRingHeader for how an external process reads from it.  It only
+ * carries 8-bit frames, so it can't be combined with shots whose Format is EXR.  A shot whose frame the
+ * reader was too far behind to take is reported as Dropped.
+ *
+ * A Supersample of N renders the shot at N times its Resolution on each axis and shrinks it back with a
+ * Lanczos filter, for stills where aliasing matters more than render time; it needs an 8-bit Format.  If N
+ * times the Resolution is beyond the largest texture the RHI allows, the largest factor which fits is used.
+ *
+ * "Samples": K averages up to K renders of an 8-bit shot, each with the engine's next sub-pixel jitter
+ * and sampling seeds, to clean up Lumen and ray-traced noise which a single frame leaves in.  With
+ * "NoiseTarget" (in 8-bit levels of standard error) it stops as soon as the average is that clean, and
+ * "FireflyClamp" (in standard deviations) keeps the odd blown-out sample from streaking the average.
+ * The noise target applies to each 64x64 tile on its own, and frames stop once every tile is that clean;
+ * each frame rendered goes into the whole average.  The report says how many frames that saved against
+ * rendering all K.
+ *
+ * FrameRate is optional too.  With it the shots form a sequence: the engine runs on a fixed time step of
+ * 1 / FrameRate, and shot N is taken once the world has ticked exactly N times since the session began,
+ * instead of whenever the real-time clock gets there.  Seed then seeds the engine's random streams as the
+ * session starts, just before the world is first stepped.
+ */
+struct FAnselBatchManifest
+{
+	FString OutputDirectory;
+	double FrameRate = 0.;
+	int32 Seed = 0;
+	FAnselBatchFrameSink FrameSink;
+	TArray<FAnselBatchShot> Shots;
+
+	static bool Parse(const FString& JsonText, FAnselBatchManifest& OutManifest, FString& OutError);
+};
+
+/** What the batch scheduler needs from the engine and the photography provider */
+class IAnselBatchHost
+{
+public:
+	virtual ~IAnselBatchHost() {}
+
+	/** Whether a photography session could be started now; the batch gives up if it isn't for minutes on end */
+	virtual bool IsReady() const = 0;
+	virtual void StartSession() = 0;
+	virtual void StopSession() = 0;
+
+	/** Moves the session camera to the shot and applies its quality profile from the next frame */
+	virtual void SetShotView(const FAnselBatchShot& Shot) = 0;
+
+	/** Starts capturing the current view; returns false if the shot's capture type can't be taken unattended */
+	virtual bool StartCapture(const FAnselBatchShot& Shot, const FString& Filename) = 0;
+	virtual bool IsCaptureInProgress() const = 0;
+
+	/** Once a capture is no longer in progress, starts its next sample if it wants more; returns false once it's written */
+	virtual bool ContinueCapture() = 0;
+	virtual FAnselAccumulationStats GetCaptureStats() const = 0;
+
+	/** Whether the last capture's frame was dropped by the frame sink rather than handed over */
+	virtual bool WasCaptureDropped() const = 0;
+
+	/** Whether the shot fits the RHI's texture limits and there's the memory to take it right now; a capture is never started otherwise */
+	virtual bool CanAffordCapture(const FAnselBatchShot& Shot, FString& OutReason) const = 0;
+
+	/** Ticks the paused world NumSteps more times; returns false if the world can't be stepped */
+	virtual bool StepWorld(int32 NumSteps) = 0;
+	virtual bool IsSteppingWorld() const = 0;
+
+	/** Sends captured frames to the ring rather than to files while it's set; null goes back to files */
+	virtual void SetFrameSink(FAnselFrameRing* FrameSink) = 0;
+
+	virtual double GetTimeSeconds() const = 0;
+	virtual int32 GetDefaultSettleFrames() const = 0;
+
+	/** Current process and GPU memory use in bytes, for the report's peaks */
+	virtual void GetMemoryUsage(uint64& OutUsedPhysical, uint64& OutUsedGPU) const = 0;
+};
+
+/**
+ * Runs the shots of a manifest back-to-back in a single photography session, so the session start-up,
+ * quality CVars and streamed content are shared between shots, and records how long each stage took.
+ * Given a shard queue, only the shots this process claims from it are taken.
+ */
+class FAnselBatchScheduler
+{
+public:
+	FAnselBatchScheduler(const FAnselBatchManifest& InManifest, IAnselBatchHost& InHost, FAnselBatchShardQueue* InShardQueue = nullptr);
+
+	/** Call once per frame */
+	void Tick();
+
+	void HandleSessionStarted();
+	void HandleSessionEnded();
+	void HandleSessionFrame(const FAnselSessionFrame& Frame);
+
+	bool IsFinished() const { return State == EState::Finished; }
+
+	/** Per-shot results and timings, frame time percentiles, memory peaks and accumulation savings as JSON */
+	FString BuildReport() const;
+
+	/**
+	 * Combines the reports of the shards of one batch into one.  Each shot's entry comes from the shard
+	 * which took it, the shards' times and frame time percentiles are the worst of them, and as the shards
+	 * run side by side their memory peaks add up.
+	 */
+	static FString MergeReports(const TArray<FString>& Reports);
+
+	/**
+	 * Compares two reports and lists every timing or memory figure which is more than ThresholdPercent
+	 * worse in Current than in Baseline, as JSON objects of Metric, Baseline, Current and ChangePercent.
+	 */
+	static TArray<TSharedPtr<FJsonValue>> FindRegressions(const FJsonObject& Baseline, const FJsonObject& Current, double ThresholdPercent);
+
+private:
+	enum class EState : uint8
+	{
+		WaitingForHost,
+		StartingSession,
+		Settling,
+		Capturing,
+		Finished
+	};
+
+	struct FShotResult
+	{
+		FString Status = TEXT("Pending");
+		FString Filename;
+		int32 SettleFrames = 0;
+		double SettleSeconds = 0.;
+		double CaptureSeconds = 0.;
+		FAnselAccumulationStats Accumulation;
+	};
+
+	void BeginNextShot();
+	void EndShot(const TCHAR* Status);
+	void FinishBatch(const TCHAR* RemainingStatus);
+
+	FAnselBatchManifest Manifest;
+	IAnselBatchHost& Host;
+	FAnselBatchShardQueue* ShardQueue;
+
+	EState State = EState::WaitingForHost;
+	int32 CurrentShot = INDEX_NONE;
+	uint32 ShotFrames = 0;
+	uint32 SettleFromFrame = 0;
+	int32 WorldSteps = 0;
+	double StageStartTime = 0.;
+
+	double BatchStartTime = 0.;
+	double SessionStartSeconds = 0.;
+	double BatchSeconds = 0.;
+	TArray<FShotResult> Results;
+
+	double LastTickTime = 0.;
+	TArray<float> FrameTimes;
+	uint64 PeakUsedPhysical = 0;
+	uint64 PeakUsedGPU = 0;
+};
+
+/**
+ * Owns a batch run started from the command line, feeding the scheduler engine ticks and session events.
+ *
+ * With -AnselBatchWorkers=<N> this process becomes the coordinator of N shards: it launches N-1 more
+ * copies of itself as workers, all of them sharing the shots through a shard queue.  A worker which exits
+ * with an error while shots remain is relaunched to pick up its claims, as is one which finished if a shot
+ * is left which no live worker holds.  Workers are marked with -AnselBatchWorker=<id>, each shard writes
+ * AnselBatchReport_<id>.json, and once every worker is done the coordinator merges them into
+ * AnselBatchReport.json.
+ *
+ * With -AnselBatchBaseline=<report.json> the run is a benchmark: its report (the merged one, if sharded)
+ * is compared against the baseline report, anything more than -AnselBatchThreshold=<percent> (default 10)
+ * slower or bigger is listed under Regressions, and the process exits with a non-zero status if there are any.
+ */
+class FAnselBatchRunner
+{
+public:
+	/** Returns null unless -AnselBatch=<manifest> is on the command line and the manifest loads */
+	static TUniquePtr<FAnselBatchRunner> CreateFromCommandLine(FAnselSessionEvents& SessionEvents, TUniquePtr<IAnselBatchHost> Host);
+
+	FAnselBatchRunner(const FAnselBatchManifest& Manifest, FAnselSessionEvents& InSessionEvents, TUniquePtr<IAnselBatchHost> InHost, TUniquePtr<FAnselBatchShardQueue> InShardQueue, TUniquePtr<FAnselFrameRing> InFrameSink);
+	~FAnselBatchRunner();
+
+	/** Starts NumWorkers worker processes sharing this runner's shard queue */
+	void LaunchWorkers(int32 NumWorkers);
+
+private:
+	struct FWorkerProcess
+	{
+		FString WorkerId;
+		FProcHandle Handle;
+		int32 NumLaunches = 0;
+	};
+
+	bool Tick(float DeltaTime);
+	bool TickWorkers();
+	void LaunchWorker(FWorkerProcess& Worker);
+
+	/** Returns the report with the regressions against the baseline added */
+	FString CompareWithBaseline(const FString& Report);
+
+	/** Gathers up every shard's report into AnselBatchReport.json */
+	void WriteMergedReport();
+
+	FAnselSessionEvents& SessionEvents;
+	TUniquePtr<IAnselBatchHost> Host;
+	TUniquePtr<FAnselBatchShardQueue> ShardQueue;
+	TUniquePtr<FAnselFrameRing> FrameSink;
+	FAnselBatchScheduler Scheduler;
+	FString OutputDirectory;
+	FString ReportFilename;
+	FString BaselineFilename;
+	double RegressionThresholdPercent = 10.;
+	bool bRegressed = false;
+
+	TArray<FWorkerProcess> Workers;
+	double LastClaimableShotsCheckTime = 0.;
+	bool bReportWritten = false;
+
+	bool bRestoreFixedTimeStep = false;
+	bool bWasUsingFixedTimeStep = false;
+	double FixedDeltaTimeBefore = 0.;
+
+	FDelegateHandle SessionStartedHandle;
+	FDelegateHandle SessionEndedHandle;
+	FDelegateHandle SessionFrameHandle;
+	FTSTicker::FDelegateHandle TickerHandle;
+};
@@ -0,0 +1,166 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselBatchShards.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogAnselBatchShards, Log, All);
+
+static const TCHAR* ClaimedStatus = TEXT("Claimed");
+
+// a worker which hasn't refreshed its heartbeat for this long is presumed dead; generous, since loading
+// a map or compiling shaders can stall the game thread for a while
+static const double HeartbeatTimeoutSeconds = 120.;
+static const double HeartbeatIntervalSeconds = 1.;
+
+// claims are only ever read or written while holding this
+class FAnselBatchClaimLock
+{
+public:
+	explicit FAnselBatchClaimLock(const FString& ClaimDirectory)
+		: Lock(FString::Printf(TEXT("AnselBatch_%s"), *FMD5::HashAnsiString(*FPaths::ConvertRelativePathToFull(ClaimDirectory))), FTimespan::FromSeconds(30.))
+	{
+		if (!Lock.IsValid())
+		{
+			UE_LOG(LogAnselBatchShards, Warning, TEXT("Timed out waiting for the batch claims lock"));
+		}
+	}
+
+	bool IsValid() const { return Lock.IsValid(); }
+
+private:
+	FSystemWideCriticalSection Lock;
+};
+
+FAnselBatchShardQueue::FAnselBatchShardQueue(const FString& InClaimDirectory, const FString& InWorkerId, int32 InNumShots)
+	: ClaimDirectory(InClaimDirectory)
+	, WorkerId(InWorkerId)
+	, NumShots(InNumShots)
+{
+	IFileManager::Get().MakeDirectory(*ClaimDirectory, true);
+}
+
+void FAnselBatchShardQueue::ResetClaims()
+{
+	FAnselBatchClaimLock Lock(ClaimDirectory);
+	IFileManager::Get().DeleteDirectory(*ClaimDirectory, false, true);
+	IFileManager::Get().MakeDirectory(*ClaimDirectory, true);
+}
+
+int32 FAnselBatchShardQueue::ClaimNextShot()
+{
+	Heartbeat();
+
+	FAnselBatchClaimLock Lock(ClaimDirectory);
+	if (!Lock.IsValid())
+	{
+		return INDEX_NONE;
+	}
+
+	for (int32 ShotIndex = 0; ShotIndex < NumShots; ++ShotIndex)
+	{
+		FClaim Claim;
+		if (ReadClaim(ShotIndex, Claim))
+		{
+			if (Claim.Status != ClaimedStatus || IsWorkerAlive(Claim.WorkerId))
+			{
+				continue; // done, or in hand
+			}
+			UE_LOG(LogAnselBatchShards, Warning, TEXT("Worker %s reclaiming shot %d from unresponsive worker %s"), *WorkerId, ShotIndex, *Claim.WorkerId);
+		}
+
+		WriteClaim(ShotIndex, ClaimedStatus);
+		return ShotIndex;
+	}
+
+	return INDEX_NONE;
+}
+
+void FAnselBatchShardQueue::MarkShotDone(int32 ShotIndex, const FString& Status)
+{
+	FAnselBatchClaimLock Lock(ClaimDirectory);
+	WriteClaim(ShotIndex, Status);
+}
+
+bool FAnselBatchShardQueue::HasUnfinishedShots()
+{
+	FAnselBatchClaimLock Lock(ClaimDirectory);
+	for (int32 ShotIndex = 0; ShotIndex < NumShots; ++ShotIndex)
+	{
+		FClaim Claim;
+		if (!ReadClaim(ShotIndex, Claim) || Claim.Status == ClaimedStatus)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FAnselBatchShardQueue::HasClaimableShots()
+{
+	FAnselBatchClaimLock Lock(ClaimDirectory);
+	for (int32 ShotIndex = 0; ShotIndex < NumShots; ++ShotIndex)
+	{
+		FClaim Claim;
+		if (!ReadClaim(ShotIndex, Claim))
+		{
+			return true;
+		}
+		if (Claim.Status == ClaimedStatus && Claim.WorkerId != WorkerId && !IsWorkerAlive(Claim.WorkerId))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FAnselBatchShardQueue::Heartbeat()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Now - LastHeartbeatTime >= HeartbeatIntervalSeconds)
+	{
+		LastHeartbeatTime = Now;
+		FFileHelper::SaveStringToFile(FString::FromInt(FPlatformProcess::GetCurrentProcessId()), *GetHeartbeatFilename(WorkerId));
+	}
+}
+
+bool FAnselBatchShardQueue::ReadClaim(int32 ShotIndex, FClaim& OutClaim) const
+{
+	FString Contents;
+	if (!FFileHelper::LoadFileToString(Contents, *GetClaimFilename(ShotIndex)))
+	{
+		return false;
+	}
+	return Contents.TrimStartAndEnd().Split(TEXT(" "), &OutClaim.WorkerId, &OutClaim.Status);
+}
+
+void FAnselBatchShardQueue::WriteClaim(int32 ShotIndex, const FString& Status) const
+{
+	FFileHelper::SaveStringToFile(WorkerId + TEXT(" ") + Status, *GetClaimFilename(ShotIndex));
+}
+
+bool FAnselBatchShardQueue::IsWorkerAlive(const FString& OtherWorkerId) const
+{
+	if (OtherWorkerId == WorkerId)
+	{
+		return false; // a claim of our own which we've not finished must be from before a restart
+	}
+
+	const FDateTime LastHeartbeat = IFileManager::Get().GetTimeStamp(*GetHeartbeatFilename(OtherWorkerId));
+	return LastHeartbeat != FDateTime::MinValue() &&
+		(FDateTime::UtcNow() - LastHeartbeat).GetTotalSeconds() < HeartbeatTimeoutSeconds;
+}
+
+FString FAnselBatchShardQueue::GetClaimFilename(int32 ShotIndex) const
+{
+	return FPaths::Combine(ClaimDirectory, FString::Printf(TEXT("Shot%05d.claim"), ShotIndex));
+}
+
+FString FAnselBatchShardQueue::GetHeartbeatFilename(const FString& OtherWorkerId) const
+{
+	return FPaths::Combine(ClaimDirectory, FString::Printf(TEXT("Worker_%s.heartbeat"), *OtherWorkerId));
+}
@@ -0,0 +1,54 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Shares the shots of a batch manifest between several game processes on one machine.  Each process
+ * claims one shot at a time from a claims directory, under a system-wide lock, so a shard which gets
+ * through its shots quickly simply claims more of them.  Every process keeps a heartbeat file fresh; a
+ * claim held by a process whose heartbeat has gone stale is handed to whoever asks next.
+ */
+class FAnselBatchShardQueue
+{
+public:
+	FAnselBatchShardQueue(const FString& InClaimDirectory, const FString& InWorkerId, int32 InNumShots);
+
+	/** Removes any claims left over from an earlier run; only the coordinator should do this, before any worker starts */
+	void ResetClaims();
+
+	/** Returns the next shot this worker should take, or INDEX_NONE if every shot is done or claimed by a live worker */
+	int32 ClaimNextShot();
+	void MarkShotDone(int32 ShotIndex, const FString& Status);
+
+	/** Whether any shot is still waiting to be taken, or held by a worker */
+	bool HasUnfinishedShots();
+
+	/** Whether any shot is waiting to be taken, or held by another worker whose heartbeat has gone stale */
+	bool HasClaimableShots();
+
+	/** Keeps this worker's claims alive; cheap enough to call every frame */
+	void Heartbeat();
+
+	const FString& GetWorkerId() const { return WorkerId; }
+
+private:
+	struct FClaim
+	{
+		FString WorkerId;
+		FString Status;
+	};
+
+	bool ReadClaim(int32 ShotIndex, FClaim& OutClaim) const;
+	void WriteClaim(int32 ShotIndex, const FString& Status) const;
+	bool IsWorkerAlive(const FString& OtherWorkerId) const;
+
+	FString GetClaimFilename(int32 ShotIndex) const;
+	FString GetHeartbeatFilename(const FString& OtherWorkerId) const;
+
+	FString ClaimDirectory;
+	FString WorkerId;
+	int32 NumShots;
+	double LastHeartbeatTime = 0.;
+};
@@ -0,0 +1,403 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselCameraConstraint.h"
+
+#include "Engine/World.h"
+#include "Engine/HitResult.h"
+#include "Misc/ScopeExit.h"
+#include "AnselStats.h"
+#include "AnselTrace.h"
+
+DECLARE_CYCLE_STAT(TEXT("Constrain Camera"), STAT_AnselConstrainCamera, STATGROUP_Ansel);
+DECLARE_CYCLE_STAT(TEXT("Constrain Camera (Async)"), STAT_AnselConstrainCameraAsync, STATGROUP_Ansel);
+
+static const ECollisionChannel ConstraintTraceChannel = ECC_Camera;
+
+// A cell's probe sphere has to cover the relevant sphere around any point in the cell, i.e. it is
+// the relevant radius plus the cell's half-diagonal.  Cells are one camera radius across.
+static const float CellHalfDiagonalScale = 0.8660254f; // sqrt(3) / 2
+
+// sweeps crossing more cells than this just sweep the whole way rather than probing every cell
+static const int32 MaxSweepCells = 32;
+
+// bound on the cache; it's simply emptied if the camera wanders far enough to fill it
+static const int32 MaxCachedCells = 16384;
+
+// an async sweep which still hasn't completed after this many frames is replaced by a synchronous one,
+// so the camera can't get stuck waiting on a query which will never come back
+static const int32 MaxPendingSweepFrames = 2;
+
+void FAnselCameraGeometryConstraint::Reset()
+{
+	Cells.Empty();
+	CachedWorld = nullptr;
+	bHasLastResult = false;
+	PendingSweep = FTraceHandle();
+	NumConstrainedFrames = 0;
+	ConstrainCycles = 0;
+}
+
+void FAnselCameraGeometryConstraint::Constrain(UWorld* World, const FVector& NewCameraLocation, const FVector& PreviousCameraLocation, const FVector& InOriginalCameraLocation, float InCameraRadius, FVector& OutCameraLocation)
+{
+	OutCameraLocation = NewCameraLocation; // accept new camera position by default
+
+	if (InCameraRadius < 0.f || World == nullptr)
+	{
+		// no constraint by collisions
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AnselConstrainCamera);
+	ANSEL_TRACE_SCOPE(FAnselCameraGeometryConstraint::Constrain);
+	LLM_SCOPE_BYTAG(Ansel);
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	ON_SCOPE_EXIT
+	{
+		++NumConstrainedFrames;
+		ConstrainCycles += FPlatformTime::Cycles64() - StartCycles;
+	};
+
+	if (CachedWorld.Get() != World || CameraRadius != InCameraRadius || OriginalCameraLocation != InOriginalCameraLocation)
+	{
+		Reset();
+		CachedWorld = World;
+		CameraRadius = InCameraRadius;
+		OriginalCameraLocation = InOriginalCameraLocation;
+		LastUnconfinedCameraLocation = InOriginalCameraLocation;
+	}
+
+	if (PreviousCameraLocation == InOriginalCameraLocation)
+	{
+		LastUnconfinedCameraLocation = InOriginalCameraLocation;
+	}
+
+	// probes are only trustworthy for as long as nothing can move
+	bUseCache = World->IsPaused() && CameraRadius > KINDA_SMALL_NUMBER;
+	if (!bUseCache)
+	{
+		Cells.Reset();
+		bHasLastResult = false;
+	}
+
+	if (bHasLastResult &&
+		NewCameraLocation == LastNewCameraLocation &&
+		PreviousCameraLocation == LastPreviousCameraLocation &&
+		LastUnconfinedCameraLocation == LastUnconfinedCameraLocationBefore)
+	{
+		// camera hasn't moved since last time; same inputs, same answer
+		OutCameraLocation = LastOutCameraLocation;
+		return;
+	}
+
+	LastUnconfinedCameraLocationBefore = LastUnconfinedCameraLocation;
+	ConstrainUncached(World, NewCameraLocation, PreviousCameraLocation, OutCameraLocation);
+
+	bHasLastResult = bUseCache;
+	LastNewCameraLocation = NewCameraLocation;
+	LastPreviousCameraLocation = PreviousCameraLocation;
+	LastOutCameraLocation = OutCameraLocation;
+
+	if (Cells.Num() > MaxCachedCells)
+	{
+		Cells.Reset();
+	}
+}
+
+void FAnselCameraGeometryConstraint::ConstrainAsync(UWorld* World, const FVector& NewCameraLocation, const FVector& PreviousCameraLocation, float InCameraRadius, float MaxStep, FVector& OutCameraLocation)
+{
+	OutCameraLocation = NewCameraLocation; // accept new camera position by default
+
+	if (InCameraRadius < 0.f || World == nullptr)
+	{
+		// no constraint by collisions
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_AnselConstrainCameraAsync);
+	ANSEL_TRACE_SCOPE(FAnselCameraGeometryConstraint::ConstrainAsync);
+	LLM_SCOPE_BYTAG(Ansel);
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	ON_SCOPE_EXIT
+	{
+		++NumConstrainedFrames;
+		ConstrainCycles += FPlatformTime::Cycles64() - StartCycles;
+	};
+
+	if (CachedWorld.Get() != World || CameraRadius != InCameraRadius)
+	{
+		Reset();
+		CachedWorld = World;
+		CameraRadius = InCameraRadius;
+	}
+
+	const FCollisionShape CameraCollisionShape = FCollisionShape::MakeSphere(CameraRadius);
+
+	// until last frame's sweep says otherwise, the camera stays where it is
+	FVector SweptLocation = PreviousCameraLocation;
+	bool bHaveSweepResult = false;
+	FTraceDatum SweepResult;
+
+	if (PendingSweep.IsValid())
+	{
+		if (World->QueryTraceData(PendingSweep, SweepResult))
+		{
+			bHaveSweepResult = true;
+			PendingSweep = FTraceHandle();
+		}
+		else if (++PendingSweepFrames > MaxPendingSweepFrames)
+		{
+			// give up waiting; redo the same sweep synchronously
+			SweepResult.Start = PendingSweepStart;
+			SweepResult.End = PendingSweepEnd;
+			FHitResult HitResult;
+			if (World->SweepSingleByChannel(HitResult, SweepResult.Start, SweepResult.End, FQuat::Identity, ConstraintTraceChannel, CameraCollisionShape))
+			{
+				SweepResult.OutHits.Add(HitResult);
+			}
+			bHaveSweepResult = true;
+			PendingSweep = FTraceHandle();
+		}
+	}
+
+	// a result only counts if the camera is still where the sweep started from
+	const FVector Motion = NewCameraLocation - PreviousCameraLocation;
+	if (bHaveSweepResult && SweepResult.Start == PreviousCameraLocation)
+	{
+		FVector SafeLocation = SweepResult.End;
+		if (SweepResult.OutHits.Num() > 0 && SweepResult.OutHits[0].bBlockingHit && !SweepResult.OutHits[0].bStartPenetrating)
+		{
+			// n.b. a camera which starts inside geometry is allowed to move freely until it's out
+			SafeLocation = SweepResult.OutHits[0].Location;
+		}
+
+		// don't follow a sweep heading away from where the user now wants to go; once they've let go, a
+		// step they asked for still stands but a guess at where they'd go next doesn't
+		const bool bFollowSweep = Motion.IsNearlyZero()
+			? !bPendingSweepAhead
+			: FVector::DotProduct(SafeLocation - PreviousCameraLocation, Motion) > 0;
+		if (bFollowSweep)
+		{
+			SweptLocation = SafeLocation;
+		}
+	}
+
+	OutCameraLocation = SweptLocation;
+
+	// clear the way for next frame's step; the step is bounded so a single sweep can't be outrun.  The
+	// camera is written back where it's put, so once it has caught up there's no step left to take; the
+	// sweep then goes on ahead along the camera's motion, so next frame's step is ready when it comes
+	if (!PendingSweep.IsValid() && !Motion.IsNearlyZero())
+	{
+		const float MaxStepSize = FMath::Max(MaxStep, 0.f);
+		FVector Step = (NewCameraLocation - SweptLocation).GetClampedToMaxSize(MaxStepSize);
+		bPendingSweepAhead = Step.IsNearlyZero();
+		if (bPendingSweepAhead)
+		{
+			Step = Motion.GetClampedToMaxSize(MaxStepSize);
+		}
+		if (!Step.IsNearlyZero())
+		{
+			PendingSweepStart = SweptLocation;
+			PendingSweepEnd = SweptLocation + Step;
+			PendingSweep = World->AsyncSweepByChannel(EAsyncTraceType::Single, PendingSweepStart, PendingSweepEnd, FQuat::Identity, ConstraintTraceChannel, CameraCollisionShape);
+			PendingSweepFrames = 0;
+		}
+	}
+}
+
+void FAnselCameraGeometryConstraint::ConstrainUncached(UWorld* World, const FVector& NewCameraLocation, const FVector& PreviousCameraLocation, FVector& OutCameraLocation)
+{
+	FVector SweepStart = LastUnconfinedCameraLocation;
+	FVector SweepEnd = NewCameraLocation;
+	FVector CastDirection = SweepEnd - SweepStart;
+
+	if (CastDirection.IsNearlyZero())
+	{
+		return; // just accept new camera position
+	}
+
+	// if our idea of an open space is actually significantly occupied - this may occur when the original camera is inside geometry - then skip the sweep and allow unconstrained camera movement until we've found a new open space
+
+	if (!IsSpaceFree(World, LastUnconfinedCameraLocation, false))
+	{
+		OutCameraLocation = NewCameraLocation;
+	}
+	else
+	{
+		// enforce camera origin remaining in line-of-sight from centre of an open space
+		FVector HitLocation;
+		if (SweepCamera(World, SweepStart, SweepEnd, HitLocation))
+		{
+			OutCameraLocation = HitLocation;
+		}
+	}
+
+	// Reject proposed camera positions which move the camera away from the rough direction which the user intends
+	if (FVector::DotProduct(OutCameraLocation - PreviousCameraLocation, NewCameraLocation - PreviousCameraLocation) <= 0)
+	{
+		OutCameraLocation = PreviousCameraLocation;
+	}
+
+	// Try to move the tracked open space origin relative to the camera movement, if there's space
+	FVector OpenSpaceCheckPos = LastUnconfinedCameraLocation + (OutCameraLocation - PreviousCameraLocation);
+
+	if (IsSpaceFree(World, OpenSpaceCheckPos, true))
+	{
+		LastUnconfinedCameraLocation = OpenSpaceCheckPos;
+	}
+	else
+	{
+		// proposed open space is blocked, check if new camera position centers on an open space
+		if (IsSpaceFree(World, OutCameraLocation, true))
+		{
+			LastUnconfinedCameraLocation = OutCameraLocation;
+		}
+	}
+}
+
+bool FAnselCameraGeometryConstraint::IsSpaceFree(UWorld* World, const FVector& Location, bool bOpenSpace)
+{
+	// a free cell settles it; an occupied cell only means the exact location needs checking
+	if (bUseCache && IsCellFree(World, GetCellCoord(Location), bOpenSpace))
+	{
+		return true;
+	}
+
+	const float Radius = bOpenSpace ? 2.f * CameraRadius : CameraRadius; // Minimum free space around camera for it to be considered unconfined
+	return !World->OverlapAnyTestByChannel(Location, FQuat::Identity, ConstraintTraceChannel, FCollisionShape::MakeSphere(Radius));
+}
+
+bool FAnselCameraGeometryConstraint::IsCellFree(UWorld* World, const FIntVector& CellCoord, bool bOpenSpace)
+{
+	FCell& Cell = Cells.FindOrAdd(CellCoord);
+	ECellProbe& Probe = bOpenSpace ? Cell.OpenSpace : Cell.CameraSpace;
+
+	if (Probe == ECellProbe::Unknown)
+	{
+		if (!bOpenSpace && Cell.OpenSpace == ECellProbe::Free)
+		{
+			// open space implies room for the camera
+			Probe = ECellProbe::Free;
+		}
+		else if (bOpenSpace && Cell.CameraSpace == ECellProbe::Occupied)
+		{
+			// no room for the camera implies no open space
+			Probe = ECellProbe::Occupied;
+		}
+		else
+		{
+			const float Radius = (bOpenSpace ? 2.f * CameraRadius : CameraRadius) + CellHalfDiagonalScale * CameraRadius;
+			const bool bOccupied = World->OverlapAnyTestByChannel(GetCellCenter(CellCoord), FQuat::Identity, ConstraintTraceChannel, FCollisionShape::MakeSphere(Radius));
+			Probe = bOccupied ? ECellProbe::Occupied : ECellProbe::Free;
+		}
+	}
+
+	return Probe == ECellProbe::Free;
+}
+
+bool FAnselCameraGeometryConstraint::SweepCamera(UWorld* World, const FVector& Start, const FVector& End, FVector& OutHitLocation)
+{
+	FVector SweepStart = Start;
+	FVector SweepEnd = End;
+
+	// each step through the cells moves one cell along one axis, so that's how many cells the path crosses
+	FIntVector CellCoord = GetCellCoord(Start);
+	const FIntVector EndCellCoord = GetCellCoord(End);
+	const int64 NumPathCells = 1 + FMath::Abs(int64(EndCellCoord.X) - CellCoord.X) + FMath::Abs(int64(EndCellCoord.Y) - CellCoord.Y) + FMath::Abs(int64(EndCellCoord.Z) - CellCoord.Z);
+
+	if (bUseCache && NumPathCells <= MaxSweepCells)
+	{
+		// walk the cells the path crosses; the sweep only has to cover the stretch from where the
+		// path enters the first cell not known to be free to where it leaves the last one
+		const FVector Delta = End - Start;
+
+		int32 Step[3];
+		double TNextBoundary[3];
+		double TPerCell[3];
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			if (Delta[Axis] > 0.)
+			{
+				Step[Axis] = 1;
+				TNextBoundary[Axis] = ((CellCoord[Axis] + 1) * double(CameraRadius) - Start[Axis]) / Delta[Axis];
+				TPerCell[Axis] = CameraRadius / Delta[Axis];
+			}
+			else if (Delta[Axis] < 0.)
+			{
+				Step[Axis] = -1;
+				TNextBoundary[Axis] = (CellCoord[Axis] * double(CameraRadius) - Start[Axis]) / Delta[Axis];
+				TPerCell[Axis] = -CameraRadius / Delta[Axis];
+			}
+			else
+			{
+				Step[Axis] = 0;
+				TNextBoundary[Axis] = TNumericLimits<double>::Max();
+				TPerCell[Axis] = TNumericLimits<double>::Max();
+			}
+		}
+
+		bool bReachedEnd = false;
+		double TEnter = 0.;
+		double TFirstUnknown = -1.;
+		double TLastUnknown = -1.;
+		for (int32 CellIndex = 0; CellIndex < MaxSweepCells; ++CellIndex)
+		{
+			const int32 Axis = (TNextBoundary[0] < TNextBoundary[1])
+				? (TNextBoundary[0] < TNextBoundary[2] ? 0 : 2)
+				: (TNextBoundary[1] < TNextBoundary[2] ? 1 : 2);
+			const double TExit = FMath::Min(TNextBoundary[Axis], 1.);
+
+			if (!IsCellFree(World, CellCoord, false))
+			{
+				if (TFirstUnknown < 0.)
+				{
+					TFirstUnknown = TEnter;
+				}
+				TLastUnknown = TExit;
+			}
+
+			if (CellCoord == EndCellCoord || TNextBoundary[Axis] >= 1.)
+			{
+				bReachedEnd = true;
+				break;
+			}
+
+			CellCoord[Axis] += Step[Axis];
+			TEnter = TNextBoundary[Axis];
+			TNextBoundary[Axis] += TPerCell[Axis];
+		}
+
+		if (bReachedEnd)
+		{
+			if (TFirstUnknown < 0.)
+			{
+				// the whole path is known to be clear
+				return false;
+			}
+
+			SweepStart = Start + Delta * TFirstUnknown;
+			SweepEnd = Start + Delta * TLastUnknown;
+		}
+	}
+
+	FHitResult HitResult;
+	if (World->SweepSingleByChannel(HitResult, SweepStart, SweepEnd, FQuat::Identity, ConstraintTraceChannel, FCollisionShape::MakeSphere(CameraRadius)))
+	{
+		OutHitLocation = HitResult.Location;
+		return true;
+	}
+	return false;
+}
+
+FIntVector FAnselCameraGeometryConstraint::GetCellCoord(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / CameraRadius),
+		FMath::FloorToInt(Location.Y / CameraRadius),
+		FMath::FloorToInt(Location.Z / CameraRadius));
+}
+
+FVector FAnselCameraGeometryConstraint::GetCellCenter(const FIntVector& CellCoord) const
+{
+	return (FVector(CellCoord) + FVector(0.5)) * CameraRadius;
+}
@@ -0,0 +1,90 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "WorldCollision.h"
+
+class UWorld;
+
+/**
+ * Keeps the photography camera in line-of-sight of the last open space it passed through, as described
+ * for UAnselFunctionLibrary::ConstrainCameraByGeometry, while avoiding repeat physics queries.
+ *
+ * While the world is paused, conservative probes of camera-sized cells are cached in a spatial hash:
+ * a cell known to be free answers overlap tests for any point inside it, and sweeps only cover the
+ * stretch between the first and last cells not known to be free.  A call with the same inputs as the
+ * previous one reuses its result without touching physics.  Nothing is cached while the world is
+ * running, since geometry may move under the camera.
+ *
+ * ConstrainAsync is a cheaper alternative which never waits on physics: each frame issues an async
+ * sweep over the next bounded step of movement, and the camera only ever moves into space swept by the
+ * previous frame's query.  Once the camera has caught up, the sweep goes on ahead along its current
+ * motion, so a camera moving steadily has its next step cleared every frame.
+ */
+class FAnselCameraGeometryConstraint
+{
+public:
+	/** Forgets the tracked open space and all cached probes; call when a new session starts */
+	void Reset();
+
+	void Constrain(UWorld* World, const FVector& NewCameraLocation, const FVector& PreviousCameraLocation, const FVector& OriginalCameraLocation, float CameraRadius, FVector& OutCameraLocation);
+
+	/** Moves the camera at most MaxStep per frame towards NewCameraLocation, one frame behind the query which cleared the way */
+	void ConstrainAsync(UWorld* World, const FVector& NewCameraLocation, const FVector& PreviousCameraLocation, float CameraRadius, float MaxStep, FVector& OutCameraLocation);
+
+	/** Whether ConstrainAsync is still clearing a step the camera was asked to take, so it should be called again even if the camera hasn't moved */
+	bool IsStepPending() const { return PendingSweep.IsValid() && !bPendingSweepAhead; }
+
+	/** Game thread time spent constraining the camera since the last Reset */
+	int32 GetNumConstrainedFrames() const { return NumConstrainedFrames; }
+	double GetConstrainSeconds() const { return FPlatformTime::ToSeconds64(ConstrainCycles); }
+
+private:
+	enum class ECellProbe : uint8
+	{
+		Unknown,
+		Free,
+		Occupied
+	};
+
+	struct FCell
+	{
+		ECellProbe CameraSpace = ECellProbe::Unknown;
+		ECellProbe OpenSpace = ECellProbe::Unknown;
+	};
+
+	void ConstrainUncached(UWorld* World, const FVector& NewCameraLocation, const FVector& PreviousCameraLocation, FVector& OutCameraLocation);
+
+	bool IsSpaceFree(UWorld* World, const FVector& Location, bool bOpenSpace);
+	bool IsCellFree(UWorld* World, const FIntVector& CellCoord, bool bOpenSpace);
+	bool SweepCamera(UWorld* World, const FVector& Start, const FVector& End, FVector& OutHitLocation);
+
+	FIntVector GetCellCoord(const FVector& Location) const;
+	FVector GetCellCenter(const FIntVector& CellCoord) const;
+
+	TMap<FIntVector, FCell> Cells;
+	bool bUseCache = false;
+
+	TWeakObjectPtr<UWorld> CachedWorld;
+	float CameraRadius = 0.f;
+	FVector OriginalCameraLocation = FVector::ZeroVector;
+	FVector LastUnconfinedCameraLocation = FVector::ZeroVector;
+
+	// inputs and result of the previous call
+	bool bHasLastResult = false;
+	FVector LastNewCameraLocation = FVector::ZeroVector;
+	FVector LastPreviousCameraLocation = FVector::ZeroVector;
+	FVector LastUnconfinedCameraLocationBefore = FVector::ZeroVector;
+	FVector LastOutCameraLocation = FVector::ZeroVector;
+
+	FTraceHandle PendingSweep;
+	FVector PendingSweepStart = FVector::ZeroVector;
+	FVector PendingSweepEnd = FVector::ZeroVector;
+	int32 PendingSweepFrames = 0;
+	bool bPendingSweepAhead = false; // a guess at the next step rather than one the camera was asked to take
+
+	int32 NumConstrainedFrames = 0;
+	uint64 ConstrainCycles = 0;
+};
@@ -0,0 +1,199 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselCaptureAsyncAction.h"
+
+#include "IAnselPlugin.h"
+#include "AnselSessionEvents.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogAnselCaptureAsyncAction, Log, All);
+
+UAnselCaptureAsyncAction* UAnselCaptureAsyncAction::Create(UObject* WorldContextObject, EWaitFor WaitFor, float TimeoutSeconds)
+{
+	UAnselCaptureAsyncAction* Action = NewObject<UAnselCaptureAsyncAction>();
+	Action->WorldContext = WorldContextObject;
+	Action->WaitFor = WaitFor;
+	Action->TimeoutSeconds = TimeoutSeconds;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+UAnselCaptureAsyncAction* UAnselCaptureAsyncAction::CaptureSuperResolution(UObject* WorldContextObject, int32 Multiplier, const FString& Filename, float TimeoutSeconds, bool bStopSessionWhenDone)
+{
+	UAnselCaptureAsyncAction* Action = Create(WorldContextObject, EWaitFor::SuperResolutionCapture, TimeoutSeconds);
+	Action->CaptureType = EAnselCaptureType::SuperResolution;
+	Action->Multiplier = Multiplier;
+	Action->Filename = Filename;
+	Action->SettleFrames = IAnselModule::IsAvailable() ? IAnselModule::Get().GetSettleFrames() : 0;
+	Action->bStopSessionWhenDone = bStopSessionWhenDone;
+	return Action;
+}
+
+UAnselCaptureAsyncAction* UAnselCaptureAsyncAction::WaitFor360Capture(UObject* WorldContextObject, bool bStereo, float TimeoutSeconds, bool bStopSessionWhenDone)
+{
+	UAnselCaptureAsyncAction* Action = Create(WorldContextObject, EWaitFor::OverlayCapture, TimeoutSeconds);
+	Action->CaptureType = bStereo ? EAnselCaptureType::Stereo360 : EAnselCaptureType::Mono360;
+	Action->bStopSessionWhenDone = bStopSessionWhenDone;
+	return Action;
+}
+
+UAnselCaptureAsyncAction* UAnselCaptureAsyncAction::WaitForQualityConverged(UObject* WorldContextObject, int32 SettleFrames, float TimeoutSeconds)
+{
+	UAnselCaptureAsyncAction* Action = Create(WorldContextObject, EWaitFor::QualityConverged, TimeoutSeconds);
+	if (SettleFrames < 0)
+	{
+		SettleFrames = IAnselModule::IsAvailable() ? IAnselModule::Get().GetSettleFrames() : 0;
+	}
+	Action->SettleFrames = SettleFrames;
+	return Action;
+}
+
+void UAnselCaptureAsyncAction::Activate()
+{
+	if (!IAnselModule::IsAvailable() ||
+		!UAnselFunctionLibrary::IsPhotographyAvailable() ||
+		!UAnselFunctionLibrary::IsPhotographyAllowed())
+	{
+		Finish(false, 0);
+		return;
+	}
+
+	FAnselSessionEvents& SessionEvents = IAnselModule::Get().GetSessionEvents();
+	SessionEndedHandle = SessionEvents.OnSessionEnded.AddUObject(this, &UAnselCaptureAsyncAction::HandleSessionEnded);
+	CaptureStartedHandle = SessionEvents.OnCaptureStarted.AddUObject(this, &UAnselCaptureAsyncAction::HandleCaptureStarted);
+	CaptureEndedHandle = SessionEvents.OnCaptureEnded.AddUObject(this, &UAnselCaptureAsyncAction::HandleCaptureEnded);
+	SessionFrameHandle = SessionEvents.OnSessionFrame.AddUObject(this, &UAnselCaptureAsyncAction::HandleSessionFrame);
+
+	if (TimeoutSeconds > 0.f)
+	{
+		// core ticker, so the timeout still runs while the photography session has the game paused
+		TimeoutHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UAnselCaptureAsyncAction::HandleTimeout), TimeoutSeconds);
+	}
+
+	// reuse a session which is already running, so back-to-back shots don't pay for session start-up
+	if (!SessionEvents.bSessionActive)
+	{
+		UAnselFunctionLibrary::StartSession(WorldContext.Get());
+	}
+}
+
+void UAnselCaptureAsyncAction::HandleSessionEnded()
+{
+	Finish(false, CaptureFrames);
+}
+
+void UAnselCaptureAsyncAction::HandleCaptureStarted(EAnselCaptureType StartedCaptureType)
+{
+	if (WaitFor == EWaitFor::OverlayCapture && StartedCaptureType == CaptureType)
+	{
+		bCaptureStarted = true;
+		CaptureFrames = 0;
+	}
+}
+
+void UAnselCaptureAsyncAction::HandleCaptureEnded(EAnselCaptureType EndedCaptureType)
+{
+	if (WaitFor == EWaitFor::OverlayCapture && bCaptureStarted && EndedCaptureType == CaptureType)
+	{
+		Finish(true, CaptureFrames);
+	}
+}
+
+void UAnselCaptureAsyncAction::HandleSessionFrame(const FAnselSessionFrame& Frame)
+{
+	if (WaitFor == EWaitFor::SuperResolutionCapture)
+	{
+		IAnselModule& AnselModule = IAnselModule::Get();
+		if (bCaptureStarted)
+		{
+			// the screenshot doesn't go through the SDK, so there are no capture events to wait on
+			if (AnselModule.IsSuperResolutionCaptureInProgress())
+			{
+				OnProgress.Broadcast(++CaptureFrames);
+			}
+			else
+			{
+				Finish(true, CaptureFrames);
+			}
+		}
+		else if (!Frame.bCaptureActive && Frame.FramesSinceViewChanged >= uint32(FMath::Max(SettleFrames, 0)))
+		{
+			FString Error;
+			bCaptureStarted = AnselModule.StartSuperResolutionCapture(Multiplier, Filename, Error);
+			if (!bCaptureStarted)
+			{
+				UE_LOG(LogAnselCaptureAsyncAction, Warning, TEXT("Can't take a super-resolution capture: %s"), *Error);
+				Finish(false, 0);
+			}
+		}
+		else
+		{
+			OnProgress.Broadcast(0);
+		}
+	}
+	else if (WaitFor == EWaitFor::OverlayCapture)
+	{
+		if (bCaptureStarted && Frame.bCaptureActive)
+		{
+			CaptureFrames = Frame.FramesSinceCaptureStart;
+			OnProgress.Broadcast(CaptureFrames);
+		}
+	}
+	else if (!Frame.bCaptureActive)
+	{
+		const int32 SettledFrames = Frame.FramesSinceViewChanged;
+		if (SettledFrames >= SettleFrames)
+		{
+			Finish(true, SettledFrames);
+		}
+		else
+		{
+			OnProgress.Broadcast(SettledFrames);
+		}
+	}
+}
+
+bool UAnselCaptureAsyncAction::HandleTimeout(float DeltaTime)
+{
+	TimeoutHandle.Reset();
+	Finish(false, CaptureFrames);
+	return false; // one-shot
+}
+
+void UAnselCaptureAsyncAction::Finish(bool bSucceeded, int32 Frames)
+{
+	if (bFinished)
+	{
+		return;
+	}
+	bFinished = true;
+
+	if (IAnselModule::IsAvailable())
+	{
+		FAnselSessionEvents& SessionEvents = IAnselModule::Get().GetSessionEvents();
+		SessionEvents.OnSessionEnded.Remove(SessionEndedHandle);
+		SessionEvents.OnCaptureStarted.Remove(CaptureStartedHandle);
+		SessionEvents.OnCaptureEnded.Remove(CaptureEndedHandle);
+		SessionEvents.OnSessionFrame.Remove(SessionFrameHandle);
+
+		if (bStopSessionWhenDone && SessionEvents.bSessionActive)
+		{
+			UAnselFunctionLibrary::StopSession(WorldContext.Get());
+		}
+	}
+	if (TimeoutHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TimeoutHandle);
+		TimeoutHandle.Reset();
+	}
+
+	if (bSucceeded)
+	{
+		OnCompleted.Broadcast(Frames);
+	}
+	else
+	{
+		OnFailed.Broadcast(Frames);
+	}
+
+	SetReadyToDestroy();
+}
@@ -0,0 +1,35 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+/**
+ * Keeps track of the exposure the renderer's eye adaptation last settled on for the game view, so a
+ * multi-part capture can pin every tile to the exposure of the whole frame seen just before it.
+ */
+class FAnselExposureProbe : public FSceneViewExtensionBase
+{
+public:
+	FAnselExposureProbe(const FAutoRegister& AutoRegister)
+		: FSceneViewExtensionBase(AutoRegister)
+	{
+	}
+
+	/** The scale applied to scene colour by eye adaptation in the last game view, or zero if there's none yet */
+	float GetLastExposure() const { return LastExposure; }
+
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override
+	{
+		if (InView.bIsGameView && InView.State)
+		{
+			LastExposure = InView.State->GetLastEyeAdaptationExposure();
+		}
+	}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override {}
+
+private:
+	float LastExposure = 0.f;
+};
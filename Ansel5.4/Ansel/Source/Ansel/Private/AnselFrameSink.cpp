@@ -0,0 +1,187 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselFrameSink.h"
+
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogAnselFrameSink, Log, All);
+
+// keep the header and every slot's pixels on their own cache lines
+static const uint32 FrameRingAlignment = 64;
+
+static uint32 GetHeaderSize()
+{
+	return Align(uint32(sizeof(FAnselFrameRingHeader)), FrameRingAlignment);
+}
+
+TUniquePtr<FAnselFrameRing> FAnselFrameRing::Create(const FString& Name, int32 NumSlots, FIntPoint MaxResolution, EAnselFrameRingPolicy Policy, double StallTimeoutSeconds)
+{
+	static_assert(std::atomic<uint64>::is_always_lock_free, "the frame ring's counters are shared between processes");
+
+	const uint64 PixelOffset = Align(uint64(sizeof(FAnselFrameRingSlot)), uint64(FrameRingAlignment));
+	const uint64 SlotSize = Align(PixelOffset + uint64(MaxResolution.X) * uint64(MaxResolution.Y) * sizeof(FColor), uint64(FrameRingAlignment));
+	if (NumSlots <= 0 || MaxResolution.X <= 0 || MaxResolution.Y <= 0 || SlotSize > MAX_uint32)
+	{
+		UE_LOG(LogAnselFrameSink, Error, TEXT("Frame ring '%s' has an unusable size (%d slots of %dx%d)"), *Name, NumSlots, MaxResolution.X, MaxResolution.Y);
+		return nullptr;
+	}
+
+	const SIZE_T RegionSize = GetHeaderSize() + SIZE_T(NumSlots) * SlotSize;
+	FPlatformMemory::FSharedMemoryRegion* Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, true,
+		FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, RegionSize);
+	if (!Region)
+	{
+		UE_LOG(LogAnselFrameSink, Error, TEXT("Couldn't map a %llu byte shared memory region named '%s'"), uint64(RegionSize), *Name);
+		return nullptr;
+	}
+
+	FAnselFrameRingHeader* Header = new (Region->GetAddress()) FAnselFrameRingHeader();
+	Header->Version = FAnselFrameRingHeader::ExpectedVersion;
+	Header->NumSlots = uint32(NumSlots);
+	Header->SlotSize = uint32(SlotSize);
+	Header->PixelOffset = uint32(PixelOffset);
+	Header->bWriterClosed.store(0);
+	Header->WriteCount.store(0);
+	Header->ReadCount.store(0);
+
+	// readers wait for the magic, so it goes in last
+	std::atomic_thread_fence(std::memory_order_release);
+	Header->Magic = FAnselFrameRingHeader::ExpectedMagic;
+
+	UE_LOG(LogAnselFrameSink, Log, TEXT("Publishing frames to '%s': %d slots of up to %dx%d"), *Name, NumSlots, MaxResolution.X, MaxResolution.Y);
+
+	return TUniquePtr<FAnselFrameRing>(new FAnselFrameRing(Region, Name, Policy, StallTimeoutSeconds));
+}
+
+FAnselFrameRing::FAnselFrameRing(FPlatformMemory::FSharedMemoryRegion* InRegion, const FString& InName, EAnselFrameRingPolicy InPolicy, double InStallTimeoutSeconds)
+	: Region(InRegion)
+	, Name(InName)
+	, Policy(InPolicy)
+	, StallTimeoutSeconds(InStallTimeoutSeconds)
+{
+}
+
+FAnselFrameRing::~FAnselFrameRing()
+{
+	GetHeader().bWriterClosed.store(1, std::memory_order_release);
+
+	UE_LOG(LogAnselFrameSink, Log, TEXT("Closing frame ring '%s': %llu frames published, %llu dropped"), *Name, NumPublished, NumDropped);
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+}
+
+uint8* FAnselFrameRing::GetSlot(uint64 Index) const
+{
+	const FAnselFrameRingHeader& Header = GetHeader();
+	return static_cast<uint8*>(Region->GetAddress()) + GetHeaderSize() + (Index % Header.NumSlots) * Header.SlotSize;
+}
+
+bool FAnselFrameRing::Publish(int32 Width, int32 Height, const FColor* Pixels, uint64 FrameNumber, double TimeSeconds)
+{
+	FAnselFrameRingHeader& Header = GetHeader();
+
+	const uint64 PixelBytes = uint64(Width) * uint64(Height) * sizeof(FColor);
+	if (Width <= 0 || Height <= 0 || Header.PixelOffset + PixelBytes > Header.SlotSize)
+	{
+		UE_LOG(LogAnselFrameSink, Warning, TEXT("Frame %llu (%dx%d) doesn't fit the slots of '%s'; dropped"), FrameNumber, Width, Height, *Name);
+		++NumDropped;
+		return false;
+	}
+
+	// only this process writes WriteCount, so it can be read relaxed
+	const uint64 WriteCount = Header.WriteCount.load(std::memory_order_relaxed);
+	const double StallStartTime = FPlatformTime::Seconds();
+	while (WriteCount - Header.ReadCount.load(std::memory_order_acquire) >= Header.NumSlots)
+	{
+		if (Policy == EAnselFrameRingPolicy::Drop || FPlatformTime::Seconds() - StallStartTime > StallTimeoutSeconds)
+		{
+			UE_LOG(LogAnselFrameSink, Warning, TEXT("Frame %llu dropped; the reader of '%s' is %u frames behind"), FrameNumber, *Name, Header.NumSlots);
+			++NumDropped;
+			return false;
+		}
+		FPlatformProcess::SleepNoStats(0.001f);
+	}
+
+	uint8* Slot = GetSlot(WriteCount);
+	FAnselFrameRingSlot& SlotHeader = *reinterpret_cast<FAnselFrameRingSlot*>(Slot);
+	SlotHeader.Width = uint32(Width);
+	SlotHeader.Height = uint32(Height);
+	SlotHeader.StrideBytes = uint32(Width * sizeof(FColor));
+	SlotHeader.Format = EAnselFrameFormat::BGRA8;
+	SlotHeader.FrameNumber = FrameNumber;
+	SlotHeader.TimeSeconds = TimeSeconds;
+	FMemory::Memcpy(Slot + Header.PixelOffset, Pixels, PixelBytes);
+
+	// publishes the slot contents along with the count
+	Header.WriteCount.store(WriteCount + 1, std::memory_order_release);
+	++NumPublished;
+	return true;
+}
+
+TUniquePtr<FAnselFrameRingReader> FAnselFrameRingReader::Open(const FString& Name)
+{
+	// the header says how big the rest of the region is
+	const FPlatformMemory::ESharedMemoryAccess Access = FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write;
+	FPlatformMemory::FSharedMemoryRegion* HeaderRegion = FPlatformMemory::MapNamedSharedMemoryRegion(Name, false, Access, GetHeaderSize());
+	if (!HeaderRegion)
+	{
+		return nullptr;
+	}
+
+	const FAnselFrameRingHeader& Header = *static_cast<const FAnselFrameRingHeader*>(HeaderRegion->GetAddress());
+	const bool bReady = Header.Magic == FAnselFrameRingHeader::ExpectedMagic;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const bool bVersionMatches = Header.Version == FAnselFrameRingHeader::ExpectedVersion;
+	const SIZE_T RegionSize = GetHeaderSize() + SIZE_T(Header.NumSlots) * Header.SlotSize;
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(HeaderRegion);
+	if (!bReady)
+	{
+		return nullptr;
+	}
+	if (!bVersionMatches)
+	{
+		UE_LOG(LogAnselFrameSink, Error, TEXT("Frame ring '%s' is a different version"), *Name);
+		return nullptr;
+	}
+
+	FPlatformMemory::FSharedMemoryRegion* Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, false, Access, RegionSize);
+	if (!Region)
+	{
+		return nullptr;
+	}
+	return TUniquePtr<FAnselFrameRingReader>(new FAnselFrameRingReader(Region));
+}
+
+FAnselFrameRingReader::FAnselFrameRingReader(FPlatformMemory::FSharedMemoryRegion* InRegion)
+	: Region(InRegion)
+{
+}
+
+FAnselFrameRingReader::~FAnselFrameRingReader()
+{
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+}
+
+bool FAnselFrameRingReader::Read(TFunctionRef<void(const FAnselFrameRingSlot& Slot, const FColor* Pixels)> Consume)
+{
+	FAnselFrameRingHeader& Header = GetHeader();
+
+	// only this process writes ReadCount, so it can be read relaxed
+	const uint64 ReadCount = Header.ReadCount.load(std::memory_order_relaxed);
+	if (ReadCount >= Header.WriteCount.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+
+	const uint8* Slot = static_cast<const uint8*>(Region->GetAddress()) + GetHeaderSize() + (ReadCount % Header.NumSlots) * Header.SlotSize;
+	Consume(*reinterpret_cast<const FAnselFrameRingSlot*>(Slot), reinterpret_cast<const FColor*>(Slot + Header.PixelOffset));
+
+	// hands the slot back to the writer only once the pixels are finished with
+	Header.ReadCount.store(ReadCount + 1, std::memory_order_release);
+	return true;
+}
+
+bool FAnselFrameRingReader::IsWriterClosed() const
+{
+	return GetHeader().bWriterClosed.load(std::memory_order_acquire) != 0;
+}
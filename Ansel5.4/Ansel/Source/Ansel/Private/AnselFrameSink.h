@@ -0,0 +1,110 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformMemory.h"
+#include <atomic>
+
+/**
+ * Layout of the shared memory region behind an FAnselFrameRing, for the process reading frames out of it.
+ *
+ * The region starts with an FAnselFrameRingHeader, followed by NumSlots slots of SlotSize bytes each.
+ * A slot starts with an FAnselFrameRingSlot and its pixels follow at PixelOffset from the slot start.
+ * There is one writer and one reader: the writer fills slot WriteCount % NumSlots and then bumps
+ * WriteCount; the reader uses slot ReadCount % NumSlots in place while ReadCount < WriteCount, and bumps
+ * ReadCount once it is done with the pixels.  FAnselFrameRingReader is a reader to copy or link against.
+ */
+enum class EAnselFrameFormat : uint32
+{
+	BGRA8 = 0,
+};
+
+struct FAnselFrameRingHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4C534E41; // 'ANSL'
+	static constexpr uint32 ExpectedVersion = 1;
+
+	uint32 Magic;
+	uint32 Version;
+	uint32 NumSlots;
+	uint32 SlotSize;
+	uint32 PixelOffset;
+	std::atomic<uint32> bWriterClosed;
+	std::atomic<uint64> WriteCount;
+	std::atomic<uint64> ReadCount;
+};
+
+struct FAnselFrameRingSlot
+{
+	uint32 Width;
+	uint32 Height;
+	uint32 StrideBytes;
+	EAnselFrameFormat Format;
+	uint64 FrameNumber; // the shot's index in the batch manifest
+	double TimeSeconds; // the shot's time in the sequence, FrameNumber / FrameRate; zero without a FrameRate
+};
+
+/**
+ * What to do with a frame when the reader has fallen a full ring behind.  Publishing happens on the game
+ * thread, so a stall holds up the whole engine and is best kept to a few frames' worth.
+ */
+enum class EAnselFrameRingPolicy : uint8
+{
+	Drop,
+	Stall,
+};
+
+/** Writer end of a named shared memory ring of captured frames */
+class FAnselFrameRing
+{
+public:
+	~FAnselFrameRing();
+
+	/** Creates the named region sized for frames of up to MaxResolution; returns null if it can't be mapped */
+	static TUniquePtr<FAnselFrameRing> Create(const FString& Name, int32 NumSlots, FIntPoint MaxResolution, EAnselFrameRingPolicy Policy, double StallTimeoutSeconds);
+
+	/** Copies a frame into the next free slot; returns false if it was dropped */
+	bool Publish(int32 Width, int32 Height, const FColor* Pixels, uint64 FrameNumber, double TimeSeconds);
+
+	const FString& GetName() const { return Name; }
+	uint64 GetNumPublished() const { return NumPublished; }
+	uint64 GetNumDropped() const { return NumDropped; }
+
+private:
+	FAnselFrameRing(FPlatformMemory::FSharedMemoryRegion* InRegion, const FString& InName, EAnselFrameRingPolicy InPolicy, double InStallTimeoutSeconds);
+
+	FAnselFrameRingHeader& GetHeader() const { return *static_cast<FAnselFrameRingHeader*>(Region->GetAddress()); }
+	uint8* GetSlot(uint64 Index) const;
+
+	FPlatformMemory::FSharedMemoryRegion* Region;
+	FString Name;
+	EAnselFrameRingPolicy Policy;
+	double StallTimeoutSeconds;
+
+	uint64 NumPublished = 0;
+	uint64 NumDropped = 0;
+};
+
+/** Reader end of a frame ring, as the process consuming the frames would have it */
+class FAnselFrameRingReader
+{
+public:
+	~FAnselFrameRingReader();
+
+	/** Maps the named region once its writer has set it up; returns null if it isn't there yet */
+	static TUniquePtr<FAnselFrameRingReader> Open(const FString& Name);
+
+	/** Hands the oldest unread frame to Consume, in place, and frees its slot; returns false if there wasn't one */
+	bool Read(TFunctionRef<void(const FAnselFrameRingSlot& Slot, const FColor* Pixels)> Consume);
+
+	/** Whether the writer has gone; frames it published before then can still be read */
+	bool IsWriterClosed() const;
+
+private:
+	explicit FAnselFrameRingReader(FPlatformMemory::FSharedMemoryRegion* InRegion);
+
+	FAnselFrameRingHeader& GetHeader() const { return *static_cast<FAnselFrameRingHeader*>(Region->GetAddress()); }
+
+	FPlatformMemory::FSharedMemoryRegion* Region;
+};
@@ -1,10 +1,10 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "AnselFunctionLibrary.h"
+#include "AnselCameraConstraint.h"
 
 #include "Engine/Engine.h"
 #include "Camera/CameraPhotography.h"
-#include "Engine/HitResult.h"
 
 static FCameraPhotographyManager* GetPhotographyManager(UObject* WorldContextObject)
 {
@@ -150,76 +150,11 @@ void UAnselFunctionLibrary::ConstrainCameraByDistance(UObject* WorldContextObjec
 
 void UAnselFunctionLibrary::ConstrainCameraByGeometry(UObject* WorldContextObject, const FVector NewCameraLocation, const FVector PreviousCameraLocation, const FVector OriginalCameraLocation, FVector& OutCameraLocation)
 {
-	OutCameraLocation = NewCameraLocation; // accept new camera position by default
-
 	static IConsoleVariable* CVarConstrainCameraSizeLocal = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Photography.Constrain.CameraSize"));
 	const float CameraRadius = CVarConstrainCameraSizeLocal->GetFloat();
 
-	if (CameraRadius < 0.f)
-	{
-		// no constraint by collisions
-		return;
-	}
-
-	const float OpenSpaceRadius = 2.f * CameraRadius; // Minimum free space around camera for it to be considered unconfined
-
-	static FVector LastUnconfinedScreenshotCamera = OriginalCameraLocation;
-	if (PreviousCameraLocation == OriginalCameraLocation)
-	{
-		LastUnconfinedScreenshotCamera = OriginalCameraLocation;
-	}
-
-	UWorld *World = WorldContextObject->GetWorld();
-	ECollisionChannel TraceChannel = ECC_Camera;
-
-	FCollisionShape CameraCollisionShape = FCollisionShape::MakeSphere(CameraRadius);
-	FCollisionShape OpenSpaceCollisionShape = FCollisionShape::MakeSphere(OpenSpaceRadius);
-
-	FVector SweepStart = LastUnconfinedScreenshotCamera;
-	FVector SweepEnd = NewCameraLocation;
-	FVector CastDirection = SweepEnd - SweepStart;
-
-	if (CastDirection.IsNearlyZero())
-	{
-		return; // just accept new camera position
-	}
-
-	FHitResult HitResult;
-
-	// if our idea of an open space is actually significantly occupied - this may occur when the original camera is inside geometry - then skip the sweep and allow unconstrained camera movement until we've found a new open space
-
-	if (World->OverlapAnyTestByChannel(LastUnconfinedScreenshotCamera, FQuat::Identity, TraceChannel, CameraCollisionShape))
-	{
-		OutCameraLocation = NewCameraLocation;
-	}
-	else
-	{
-		// enforce camera origin remaining in line-of-sight from centre of an open space
-		if (World->SweepSingleByChannel(HitResult, SweepStart, SweepEnd, FQuat::Identity, TraceChannel, CameraCollisionShape))
-		{
-			OutCameraLocation = HitResult.Location;
-		}
-	}
-
-	// Reject proposed camera positions which move the camera away from the rough direction which the user intends
-	if (FVector::DotProduct(OutCameraLocation - PreviousCameraLocation, NewCameraLocation - PreviousCameraLocation) <= 0)
-	{
-		OutCameraLocation = PreviousCameraLocation;
-	}
-
-	// Try to move the tracked open space origin relative to the camera movement, if there's space
-	FVector OpenSpaceCheckPos = LastUnconfinedScreenshotCamera + (OutCameraLocation - PreviousCameraLocation);
-
-	if (! World->OverlapAnyTestByChannel(OpenSpaceCheckPos, FQuat::Identity, TraceChannel, OpenSpaceCollisionShape))
-	{
-		LastUnconfinedScreenshotCamera = OpenSpaceCheckPos;
-	}
-	else
-	{
-		// proposed open space is blocked, check if new camera position centers on an open space
-		if (! World->OverlapAnyTestByChannel(OutCameraLocation, FQuat::Identity, TraceChannel, OpenSpaceCollisionShape))
-		{
-			LastUnconfinedScreenshotCamera = OutCameraLocation;
-		}
-	}
+	// the default camera constraint keeps its own per-session instance; this one serves custom
+	// PhotographyCameraModify implementations and starts afresh whenever the original camera moves
+	static FAnselCameraGeometryConstraint GeometryConstraint;
+	GeometryConstraint.Constrain(WorldContextObject->GetWorld(), NewCameraLocation, PreviousCameraLocation, OriginalCameraLocation, CameraRadius, OutCameraLocation);
 }
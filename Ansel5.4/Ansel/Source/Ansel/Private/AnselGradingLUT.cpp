@@ -0,0 +1,261 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselGradingLUT.h"
+
+#include "AnselTrace.h"
+#include "Async/ParallelFor.h"
+#include "Engine/Texture2D.h"
+#include "Misc/FileHelper.h"
+
+// the tonemapper samples ColorGradingLUT as a 16x16x16 cube unwrapped into a 256x16 strip of blue slices
+static const int32 EngineLUTSize = 16;
+
+// small enough to keep every worker busy, big enough that scheduling a band is noise
+static const int32 RowsPerBand = 16;
+
+struct FCubeFile
+{
+	int32 Size = 0;
+	FVector3f DomainMin = FVector3f(0.f);
+	FVector3f DomainMax = FVector3f(1.f);
+	TArray<FVector3f> Table; // red varies fastest, then green, then blue
+};
+
+static bool ParseCubeFile(const FString& Text, FCubeFile& OutCube, FString& OutError)
+{
+	TArray<FString> Lines;
+	Text.ParseIntoArrayLines(Lines);
+	for (const FString& RawLine : Lines)
+	{
+		const FString Line = RawLine.TrimStartAndEnd();
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#")) || Line.StartsWith(TEXT("TITLE")))
+		{
+			continue;
+		}
+
+		TArray<FString> Tokens;
+		Line.ParseIntoArrayWS(Tokens);
+		if (Tokens[0] == TEXT("LUT_3D_SIZE") && Tokens.Num() == 2)
+		{
+			OutCube.Size = FCString::Atoi(*Tokens[1]);
+		}
+		else if (Tokens[0] == TEXT("LUT_1D_SIZE"))
+		{
+			OutError = TEXT("1D LUTs aren't supported");
+			return false;
+		}
+		else if (Tokens[0] == TEXT("DOMAIN_MIN") && Tokens.Num() == 4)
+		{
+			OutCube.DomainMin = FVector3f(FCString::Atof(*Tokens[1]), FCString::Atof(*Tokens[2]), FCString::Atof(*Tokens[3]));
+		}
+		else if (Tokens[0] == TEXT("DOMAIN_MAX") && Tokens.Num() == 4)
+		{
+			OutCube.DomainMax = FVector3f(FCString::Atof(*Tokens[1]), FCString::Atof(*Tokens[2]), FCString::Atof(*Tokens[3]));
+		}
+		else if (Tokens[0] == TEXT("LUT_3D_INPUT_RANGE") && Tokens.Num() == 3)
+		{
+			OutCube.DomainMin = FVector3f(FCString::Atof(*Tokens[1]));
+			OutCube.DomainMax = FVector3f(FCString::Atof(*Tokens[2]));
+		}
+		else if (Tokens.Num() == 3 && (FChar::IsDigit(Tokens[0][0]) || Tokens[0][0] == TCHAR('-') || Tokens[0][0] == TCHAR('.')))
+		{
+			OutCube.Table.Emplace(FCString::Atof(*Tokens[0]), FCString::Atof(*Tokens[1]), FCString::Atof(*Tokens[2]));
+		}
+		else
+		{
+			OutError = FString::Printf(TEXT("unrecognised line '%s'"), *Line);
+			return false;
+		}
+	}
+
+	if (OutCube.Size < 2 || OutCube.Size > 256)
+	{
+		OutError = FString::Printf(TEXT("LUT_3D_SIZE %d is missing or out of range"), OutCube.Size);
+		return false;
+	}
+	if (OutCube.Table.Num() != OutCube.Size * OutCube.Size * OutCube.Size)
+	{
+		OutError = FString::Printf(TEXT("%d entries where LUT_3D_SIZE %d needs %d"), OutCube.Table.Num(), OutCube.Size, OutCube.Size * OutCube.Size * OutCube.Size);
+		return false;
+	}
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (!(OutCube.DomainMax[Axis] > OutCube.DomainMin[Axis]))
+		{
+			OutError = TEXT("DOMAIN_MAX must be above DOMAIN_MIN");
+			return false;
+		}
+	}
+	return true;
+}
+
+// Coord is in table cells, i.e. 0 to Size - 1 on each axis; splits the cell into six tetrahedra along its
+// neutral diagonal, which keeps greys grey where trilinear filtering would tint them
+static FVector3f SampleTetrahedral(const TArray<FVector3f>& Table, int32 Size, const FVector3f& Coord)
+{
+	auto At = [&Table, Size](int32 R, int32 G, int32 B) -> const FVector3f& { return Table[R + Size * (G + Size * B)]; };
+
+	const int32 R0 = FMath::Clamp(FMath::FloorToInt32(Coord.X), 0, Size - 2);
+	const int32 G0 = FMath::Clamp(FMath::FloorToInt32(Coord.Y), 0, Size - 2);
+	const int32 B0 = FMath::Clamp(FMath::FloorToInt32(Coord.Z), 0, Size - 2);
+	const int32 R1 = R0 + 1;
+	const int32 G1 = G0 + 1;
+	const int32 B1 = B0 + 1;
+	const float FR = Coord.X - R0;
+	const float FG = Coord.Y - G0;
+	const float FB = Coord.Z - B0;
+
+	const FVector3f& C000 = At(R0, G0, B0);
+	const FVector3f& C111 = At(R1, G1, B1);
+	if (FR > FG)
+	{
+		if (FG > FB)
+		{
+			return C000 + (At(R1, G0, B0) - C000) * FR + (At(R1, G1, B0) - At(R1, G0, B0)) * FG + (C111 - At(R1, G1, B0)) * FB;
+		}
+		if (FR > FB)
+		{
+			return C000 + (At(R1, G0, B0) - C000) * FR + (At(R1, G0, B1) - At(R1, G0, B0)) * FB + (C111 - At(R1, G0, B1)) * FG;
+		}
+		return C000 + (At(R0, G0, B1) - C000) * FB + (At(R1, G0, B1) - At(R0, G0, B1)) * FR + (C111 - At(R1, G0, B1)) * FG;
+	}
+	if (FB > FG)
+	{
+		return C000 + (At(R0, G0, B1) - C000) * FB + (At(R0, G1, B1) - At(R0, G0, B1)) * FG + (C111 - At(R0, G1, B1)) * FR;
+	}
+	if (FB > FR)
+	{
+		return C000 + (At(R0, G1, B0) - C000) * FG + (At(R0, G1, B1) - At(R0, G1, B0)) * FB + (C111 - At(R0, G1, B1)) * FR;
+	}
+	return C000 + (At(R0, G1, B0) - C000) * FG + (At(R1, G1, B0) - At(R0, G1, B0)) * FR + (C111 - At(R1, G1, B0)) * FB;
+}
+
+bool FAnselGradingLUT::LoadCubeFile(const FString& Filename, FString& OutError)
+{
+	ANSEL_TRACE_SCOPE(FAnselGradingLUT::LoadCubeFile);
+
+	FString Text;
+	if (!FFileHelper::LoadFileToString(Text, *Filename))
+	{
+		OutError = TEXT("couldn't read the file");
+		return false;
+	}
+
+	FCubeFile Cube;
+	if (!ParseCubeFile(Text, Cube, OutError))
+	{
+		return false;
+	}
+
+	Size = Cube.Size;
+	DomainMin = Cube.DomainMin;
+	DomainMax = Cube.DomainMax;
+	Table = MoveTemp(Cube.Table);
+	return true;
+}
+
+FVector3f FAnselGradingLUT::Sample(const FVector3f& Input) const
+{
+	const FVector3f CellsPerUnit = FVector3f(float(Size - 1)) / (DomainMax - DomainMin);
+	const FVector3f Coord = ((Input - DomainMin) * CellsPerUnit).BoundToBox(FVector3f(0.f), FVector3f(float(Size - 1)));
+	return SampleTetrahedral(Table, Size, Coord);
+}
+
+void FAnselGradingLUT::Apply(const FColor* Src, FColor* Dst, FIntPoint ImageSize) const
+{
+	ANSEL_TRACE_SCOPE(FAnselGradingLUT::Apply);
+	check(Size >= 2);
+
+	// an 8-bit channel only has 256 levels, so where each lands in the table is worked out once
+	TArray<float> Coords[3];
+	const FVector3f CellsPerUnit = FVector3f(float(Size - 1)) / (DomainMax - DomainMin);
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		Coords[Axis].SetNumUninitialized(256);
+		for (int32 Level = 0; Level < 256; ++Level)
+		{
+			Coords[Axis][Level] = FMath::Clamp((float(Level) / 255.f - DomainMin[Axis]) * CellsPerUnit[Axis], 0.f, float(Size - 1));
+		}
+	}
+
+	const int32 NumBands = FMath::DivideAndRoundUp(ImageSize.Y, RowsPerBand);
+	ParallelFor(NumBands, [&](int32 Band)
+	{
+		const int32 EndY = FMath::Min((Band + 1) * RowsPerBand, ImageSize.Y);
+		const int64 End = int64(EndY) * ImageSize.X;
+		for (int64 Index = int64(Band) * RowsPerBand * ImageSize.X; Index < End; ++Index)
+		{
+			const FColor Pixel = Src[Index];
+			const FVector3f Output = SampleTetrahedral(Table, Size, FVector3f(Coords[0][Pixel.R], Coords[1][Pixel.G], Coords[2][Pixel.B]));
+			FColor Graded = FLinearColor(Output.X, Output.Y, Output.Z).ToFColor(false);
+			Graded.A = Pixel.A;
+			Dst[Index] = Graded;
+		}
+	});
+}
+
+UTexture2D* FAnselGradingLUT::CreateTexture(FName Name, UTexture2D* BaseLUT, float BaseIntensity) const
+{
+	ANSEL_TRACE_SCOPE(FAnselGradingLUT::CreateTexture);
+
+	// the scene's LUT, as the tonemapper would apply it, in the same layout as the one made here
+	TArray<FColor> BasePixels;
+	if (BaseLUT)
+	{
+#if WITH_EDITORONLY_DATA
+		TArray64<uint8> MipData;
+		if (BaseLUT->Source.IsValid() && BaseLUT->Source.GetFormat() == TSF_BGRA8 &&
+			BaseLUT->Source.GetSizeX() == EngineLUTSize * EngineLUTSize && BaseLUT->Source.GetSizeY() == EngineLUTSize &&
+			BaseLUT->Source.GetMipData(MipData, 0))
+		{
+			BasePixels.SetNumUninitialized(EngineLUTSize * EngineLUTSize * EngineLUTSize);
+			FMemory::Memcpy(BasePixels.GetData(), MipData.GetData(), BasePixels.Num() * BasePixels.GetTypeSize());
+		}
+#endif
+		if (BasePixels.Num() == 0)
+		{
+			return nullptr;
+		}
+	}
+
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(EngineLUTSize * EngineLUTSize * EngineLUTSize);
+	for (int32 B = 0; B < EngineLUTSize; ++B)
+	{
+		for (int32 G = 0; G < EngineLUTSize; ++G)
+		{
+			for (int32 R = 0; R < EngineLUTSize; ++R)
+			{
+				const int32 Index = G * EngineLUTSize * EngineLUTSize + B * EngineLUTSize + R;
+				FVector3f Input = FVector3f(float(R), float(G), float(B)) / float(EngineLUTSize - 1);
+				if (BasePixels.Num() > 0)
+				{
+					const FLinearColor Base = BasePixels[Index].ReinterpretAsLinear();
+					Input = FMath::Lerp(Input, FVector3f(Base.R, Base.G, Base.B), BaseIntensity);
+				}
+				const FVector3f Output = Sample(Input);
+				Pixels[Index] = FLinearColor(Output.X, Output.Y, Output.Z).ToFColor(false);
+			}
+		}
+	}
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(EngineLUTSize * EngineLUTSize, EngineLUTSize, PF_B8G8R8A8, Name);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	// laid out and filtered like an imported LUT strip, so the tonemapper treats it the same way
+	Texture->SRGB = true;
+	Texture->Filter = TF_Bilinear;
+	Texture->AddressX = TA_Clamp;
+	Texture->AddressY = TA_Clamp;
+	Texture->LODGroup = TEXTUREGROUP_ColorLookupTable;
+
+	FTexture2DMipMap& Mip = Texture->GetPlatformData()->Mips[0];
+	FMemory::Memcpy(Mip.BulkData.Lock(LOCK_READ_WRITE), Pixels.GetData(), Pixels.Num() * Pixels.GetTypeSize());
+	Mip.BulkData.Unlock();
+	Texture->UpdateResource();
+
+	return Texture;
+}
@@ -0,0 +1,45 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture2D;
+
+/**
+ * A studio .cube 3D LUT.  Batch shots, whose pixels the plugin reads back, are graded through the full
+ * table on the CPU.  Captures the SDK stitches itself can only be graded by the tonemapper, which takes a
+ * 16x16x16 LUT, so for those the table is resampled into the post-process settings' colour grading LUT.
+ */
+class FAnselGradingLUT
+{
+public:
+	/** Loads a .cube file; returns false and says why in OutError if the file can't be used */
+	bool LoadCubeFile(const FString& Filename, FString& OutError);
+
+	/** Entries along each axis of the table */
+	int32 GetSize() const { return Size; }
+
+	/**
+	 * Grades an 8-bit image through the full table with tetrahedral interpolation; Src and Dst may be the
+	 * same.  Bands of rows are graded in parallel.
+	 */
+	void Apply(const FColor* Src, FColor* Dst, FIntPoint ImageSize) const;
+
+	/**
+	 * Resamples the table, with tetrahedral interpolation, into the engine's 256x16 LUT layout as a
+	 * transient texture.  Given the scene's own colour grading LUT, the texture applies that first, at
+	 * BaseIntensity, and this table after it; that needs BaseLUT's source pixels, so returns null without
+	 * them, as in cooked builds.
+	 */
+	UTexture2D* CreateTexture(FName Name, UTexture2D* BaseLUT, float BaseIntensity) const;
+
+private:
+	/** Input is in the table's domain, DomainMin to DomainMax on each axis */
+	FVector3f Sample(const FVector3f& Input) const;
+
+	int32 Size = 0;
+	FVector3f DomainMin = FVector3f(0.f);
+	FVector3f DomainMax = FVector3f(1.f);
+	TArray<FVector3f> Table; // red varies fastest, then green, then blue
+};
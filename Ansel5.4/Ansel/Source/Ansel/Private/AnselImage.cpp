@@ -0,0 +1,102 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselImage.h"
+
+#include "AnselTrace.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+static const int32 LanczosLobes = 3;
+
+// small enough to keep every worker busy, big enough that scheduling a band is noise
+static const int32 RowsPerBand = 16;
+
+static float Lanczos3(float X)
+{
+	X = FMath::Abs(X);
+	if (X < UE_SMALL_NUMBER)
+	{
+		return 1.f;
+	}
+	if (X >= LanczosLobes)
+	{
+		return 0.f;
+	}
+	const float PiX = UE_PI * X;
+	return LanczosLobes * FMath::Sin(PiX) * FMath::Sin(PiX / LanczosLobes) / (PiX * PiX);
+}
+
+void AnselImage::DownsampleLanczos3(const FColor* Src, FIntPoint SrcSize, int32 Factor, TArray<FColor>& OutDst, FIntPoint& OutDstSize)
+{
+	ANSEL_TRACE_SCOPE(AnselImage::DownsampleLanczos3);
+	check(Factor >= 1);
+
+	OutDstSize = FIntPoint(SrcSize.X / Factor, SrcSize.Y / Factor);
+	OutDst.SetNumUninitialized(FMath::Max(OutDstSize.X, 0) * FMath::Max(OutDstSize.Y, 0));
+	if (OutDst.Num() == 0)
+	{
+		return;
+	}
+
+	// with a whole factor every output pixel lies the same way over the source, so one set of taps serves
+	// every pixel on both axes: output pixel I is filtered from source pixels I * Factor + Offsets[Tap]
+	TArray<int32> Offsets;
+	TArray<float> Weights;
+	const float Center = 0.5f * float(Factor - 1);
+	float WeightSum = 0.f;
+	for (int32 Offset = FMath::CeilToInt32(Center - LanczosLobes * Factor); Offset <= FMath::FloorToInt32(Center + LanczosLobes * Factor); ++Offset)
+	{
+		const float Weight = Lanczos3((float(Offset) - Center) / float(Factor));
+		if (Weight != 0.f)
+		{
+			Offsets.Add(Offset);
+			Weights.Add(Weight);
+			WeightSum += Weight;
+		}
+	}
+	for (float& Weight : Weights)
+	{
+		Weight /= WeightSum;
+	}
+
+	const int32 NumBands = FMath::DivideAndRoundUp(OutDstSize.Y, RowsPerBand);
+	ParallelFor(NumBands, [&](int32 Band)
+	{
+		// one source-width row at a time, already filtered vertically
+		TArray<FLinearColor> Row;
+		Row.SetNumUninitialized(SrcSize.X);
+
+		const int32 EndY = FMath::Min((Band + 1) * RowsPerBand, OutDstSize.Y);
+		for (int32 DstY = Band * RowsPerBand; DstY < EndY; ++DstY)
+		{
+			FMemory::Memzero(Row.GetData(), Row.Num() * sizeof(FLinearColor));
+			for (int32 Tap = 0; Tap < Offsets.Num(); ++Tap)
+			{
+				const int32 SrcY = FMath::Clamp(DstY * Factor + Offsets[Tap], 0, SrcSize.Y - 1);
+				const FColor* SrcRow = Src + int64(SrcY) * SrcSize.X;
+				const VectorRegister4Float Weight = VectorSetFloat1(Weights[Tap]);
+				for (int32 X = 0; X < SrcSize.X; ++X)
+				{
+					const FLinearColor Texel = FLinearColor::FromSRGBColor(SrcRow[X]);
+					VectorStore(VectorMultiplyAdd(VectorLoad(&Texel.R), Weight, VectorLoad(&Row[X].R)), &Row[X].R);
+				}
+			}
+
+			FColor* DstRow = OutDst.GetData() + int64(DstY) * OutDstSize.X;
+			for (int32 DstX = 0; DstX < OutDstSize.X; ++DstX)
+			{
+				VectorRegister4Float Sum = VectorZeroFloat();
+				for (int32 Tap = 0; Tap < Offsets.Num(); ++Tap)
+				{
+					const int32 SrcX = FMath::Clamp(DstX * Factor + Offsets[Tap], 0, SrcSize.X - 1);
+					Sum = VectorMultiplyAdd(VectorLoad(&Row[SrcX].R), VectorSetFloat1(Weights[Tap]), Sum);
+				}
+
+				// the negative lobes can ring past the ends of the range, which ToFColorSRGB clamps away
+				FLinearColor Filtered;
+				VectorStore(Sum, &Filtered.R);
+				DstRow[DstX] = Filtered.ToFColorSRGB();
+			}
+		}
+	});
+}
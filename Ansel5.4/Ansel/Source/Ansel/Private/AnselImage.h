@@ -0,0 +1,16 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** CPU work on captured frames which the engine doesn't already do on the GPU */
+namespace AnselImage
+{
+	/**
+	 * Shrinks an 8-bit sRGB image by a whole Factor on each axis with a Lanczos-3 filter, in linear light.
+	 * Bands of output rows are filtered in parallel, each from just the source rows under it, so nothing
+	 * but the source is ever held at full size.
+	 */
+	void DownsampleLanczos3(const FColor* Src, FIntPoint SrcSize, int32 Factor, TArray<FColor>& OutDst, FIntPoint& OutDstSize);
+}
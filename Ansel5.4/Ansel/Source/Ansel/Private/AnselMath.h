@@ -0,0 +1,81 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <AnselSDK.h>
+
+/**
+ * The plugin's engine-independent arithmetic: converting between the SDK's camera and world space, and
+ * between overlay slider positions and effect values.  Only Core math types and SDK structs are used
+ * here, so none of it needs a world, a viewport or a running session.
+ */
+namespace AnselMath
+{
+	inline bool CamerasMatch(const ansel::Camera& A, const ansel::Camera& B)
+	{
+		return A.position.x == B.position.x &&
+			A.position.y == B.position.y &&
+			A.position.z == B.position.z &&
+			A.rotation.x == B.rotation.x &&
+			A.rotation.y == B.rotation.y &&
+			A.rotation.z == B.rotation.z &&
+			A.rotation.w == B.rotation.w &&
+			A.fov == B.fov &&
+			A.projectionOffsetX == B.projectionOffsetX &&
+			A.projectionOffsetY == B.projectionOffsetY;
+	}
+
+	/** Cameras are only the same view if their positions are relative to the same origin, as a scripted view moves it */
+	inline bool ViewsMatch(const ansel::Camera& A, const FVector& OriginA, const ansel::Camera& B, const FVector& OriginB)
+	{
+		return OriginA == OriginB && CamerasMatch(A, B);
+	}
+
+	/** The SDK's camera positions are relative to a session origin, see FNVAnselCameraPhotographyPrivate::RebaseAnselCameraOrigin */
+	inline FVector PositionToWorld(const nv::Vec3& AnselPosition, const FVector& Origin)
+	{
+		return Origin + FVector(AnselPosition.x, AnselPosition.y, AnselPosition.z);
+	}
+
+	inline nv::Vec3 WorldToPosition(const FVector& WorldPosition, const FVector& Origin)
+	{
+		const FVector Relative = WorldPosition - Origin;
+		return { float(Relative.X), float(Relative.Y), float(Relative.Z) };
+	}
+
+	inline FRotator RotationToWorld(const nv::Quat& AnselRotation)
+	{
+		return FRotator(FQuat(AnselRotation.x, AnselRotation.y, AnselRotation.z, AnselRotation.w));
+	}
+
+	inline nv::Quat WorldToRotation(const FRotator& WorldRotation)
+	{
+		const FQuat Quat = WorldRotation.Quaternion();
+		return { float(Quat.X), float(Quat.Y), float(Quat.Z), float(Quat.W) };
+	}
+
+	/** Moves the origin onto the position if the position has strayed further than MaxOffset from it; returns whether it moved */
+	inline bool RebaseOrigin(nv::Vec3& InOutPosition, FVector& InOutOrigin, float MaxOffset)
+	{
+		const FVector Offset(InOutPosition.x, InOutPosition.y, InOutPosition.z);
+		if (Offset.GetAbsMax() <= MaxOffset)
+		{
+			return false;
+		}
+		InOutOrigin += Offset;
+		InOutPosition = { 0.f, 0.f, 0.f };
+		return true;
+	}
+
+	/** Overlay sliders run from 0 to 1 across the control's range */
+	inline float SliderToValue(float Slider, float Min, float Max)
+	{
+		return FMath::Lerp(Min, Max, Slider);
+	}
+
+	inline float ValueToSlider(float Value, float Min, float Max)
+	{
+		return FMath::GetRangePct(Min, Max, Value);
+	}
+}
@@ -0,0 +1,74 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselMemoryBudget.h"
+
+#include "HAL/PlatformMemory.h"
+#include "DynamicRHI.h"
+#include "AnselStats.h"
+
+LLM_DEFINE_TAG(Ansel);
+
+// A full-resolution frame needs the scene's render targets (GBuffer, scene colour and depth, TAA
+// history, post-processing chain) at that size on the GPU, and the readback plus the encoded image on
+// the CPU.  These are deliberately pessimistic per-pixel figures for a deferred renderer.
+static const uint64 ScreenshotGPUBytesPerPixel = 96;
+static const uint64 ScreenshotPhysicalBytesPerPixel = 12;
+
+// an HDR screenshot reads back FLinearColor and encodes half-float EXR instead
+static const uint64 HDRScreenshotPhysicalBytesPerPixel = 24;
+
+static uint64 SubtractHeadroom(uint64 Available, uint64 Headroom)
+{
+	return Available > Headroom ? Available - Headroom : 0;
+}
+
+FAnselMemoryBudget FAnselMemoryBudget::Query(int32 HeadroomMB)
+{
+	FAnselMemoryBudget Budget;
+	Budget.HeadroomBytes = uint64(FMath::Max(HeadroomMB, 0)) * 1024 * 1024;
+	Budget.AvailablePhysical = SubtractHeadroom(FPlatformMemory::GetStats().AvailablePhysical, Budget.HeadroomBytes);
+
+	FTextureMemoryStats TextureMemoryStats;
+	RHIGetTextureMemoryStats(TextureMemoryStats);
+	if (TextureMemoryStats.DedicatedVideoMemory > 0)
+	{
+		Budget.DedicatedGPU = uint64(TextureMemoryStats.DedicatedVideoMemory);
+		const uint64 Allocated = uint64(FMath::Max<int64>(TextureMemoryStats.AllocatedMemorySize, 0));
+		Budget.AvailableGPU = SubtractHeadroom(Budget.DedicatedGPU > Allocated ? Budget.DedicatedGPU - Allocated : 0, Budget.HeadroomBytes);
+	}
+	return Budget;
+}
+
+int32 FAnselMemoryBudget::GetAffordableStreamingPoolMB(int32 DesiredMB, int32 CurrentPoolMB) const
+{
+	if (DedicatedGPU == 0)
+	{
+		return 0;
+	}
+
+	// the pool shares the card with everything else the renderer allocates, so it may grow into what's
+	// free once the headroom is set aside, plus what it already holds, which counts as allocated
+	const int64 AffordableMB = int64(AvailableGPU / (1024 * 1024)) + FMath::Max(CurrentPoolMB, 0);
+	return int32(FMath::Clamp<int64>(AffordableMB, 0, DesiredMB));
+}
+
+bool FAnselMemoryBudget::CanAffordScreenshot(FIntPoint Resolution, bool bHDR, FString& OutReason) const
+{
+	const uint64 NumPixels = uint64(FMath::Max(Resolution.X, 0)) * uint64(FMath::Max(Resolution.Y, 0));
+
+	const uint64 ProjectedPhysical = NumPixels * (bHDR ? HDRScreenshotPhysicalBytesPerPixel : ScreenshotPhysicalBytesPerPixel);
+	if (ProjectedPhysical > AvailablePhysical)
+	{
+		OutReason = FString::Printf(TEXT("%dx%d needs ~%llu MB of RAM, %llu MB free"), Resolution.X, Resolution.Y, ProjectedPhysical >> 20, AvailablePhysical >> 20);
+		return false;
+	}
+
+	const uint64 ProjectedGPU = NumPixels * ScreenshotGPUBytesPerPixel;
+	if (DedicatedGPU > 0 && ProjectedGPU > AvailableGPU)
+	{
+		OutReason = FString::Printf(TEXT("%dx%d needs ~%llu MB of video memory, %llu MB free"), Resolution.X, Resolution.Y, ProjectedGPU >> 20, AvailableGPU >> 20);
+		return false;
+	}
+
+	return true;
+}
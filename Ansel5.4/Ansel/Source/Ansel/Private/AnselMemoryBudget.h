@@ -0,0 +1,29 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Keeps photography from pushing the machine into paging: estimates what a capture or a quality
+ * setting will need and compares it against the memory actually free right now, less some headroom.
+ */
+struct FAnselMemoryBudget
+{
+	/** Free memory right now; the GPU figure is only an estimate, and zero if the RHI can't tell */
+	uint64 AvailablePhysical = 0;
+	uint64 AvailableGPU = 0;
+	uint64 DedicatedGPU = 0;
+
+	/** Samples current memory use, keeping HeadroomMB of each kind of memory in reserve */
+	static FAnselMemoryBudget Query(int32 HeadroomMB);
+
+	/** The largest texture streaming pool, up to DesiredMB, which the GPU can hold alongside what's already allocated besides the CurrentPoolMB pool; zero if the GPU's size is unknown */
+	int32 GetAffordableStreamingPoolMB(int32 DesiredMB, int32 CurrentPoolMB) const;
+
+	/** Whether rendering and saving a screenshot of this size, 8-bit or HDR, fits; OutReason says what doesn't if not */
+	bool CanAffordScreenshot(FIntPoint Resolution, bool bHDR, FString& OutReason) const;
+
+private:
+	uint64 HeadroomBytes = 0;
+};
@@ -0,0 +1,11 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Stats/Stats.h"
+#include "HAL/LowLevelMemTracker.h"
+
+DECLARE_STATS_GROUP(TEXT("Ansel"), STATGROUP_Ansel, STATCAT_Advanced);
+
+// everything the plugin allocates, for -llm / memreport
+LLM_DECLARE_TAG(Ansel);
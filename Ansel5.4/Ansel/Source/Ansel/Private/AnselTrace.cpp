@@ -0,0 +1,73 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselTrace.h"
+
+#include "HAL/PlatformTime.h"
+#include "Misc/MiscTrace.h"
+
+UE_TRACE_CHANNEL_DEFINE(AnselChannel)
+
+UE_TRACE_EVENT_BEGIN(Ansel, Transition)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint8, Kind)
+	UE_TRACE_EVENT_FIELD(uint8, CaptureType)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(Ansel, CaptureTile)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, TileIndex)
+	UE_TRACE_EVENT_FIELD(float, ProjectionOffsetX)
+	UE_TRACE_EVENT_FIELD(float, ProjectionOffsetY)
+UE_TRACE_EVENT_END()
+
+namespace AnselTrace
+{
+	enum class ETransition : uint8
+	{
+		SessionStarted,
+		SessionEnded,
+		CaptureStarted,
+		CaptureEnded
+	};
+
+	static void EmitTransition(ETransition Kind, EAnselCaptureType CaptureType)
+	{
+		UE_TRACE_LOG(Ansel, Transition, AnselChannel)
+			<< Transition.Cycle(FPlatformTime::Cycles64())
+			<< Transition.Kind(uint8(Kind))
+			<< Transition.CaptureType(uint8(CaptureType));
+	}
+
+	void SessionStarted()
+	{
+		EmitTransition(ETransition::SessionStarted, EAnselCaptureType::SuperResolution);
+		TRACE_BOOKMARK(TEXT("Ansel session started"));
+	}
+
+	void SessionEnded()
+	{
+		EmitTransition(ETransition::SessionEnded, EAnselCaptureType::SuperResolution);
+		TRACE_BOOKMARK(TEXT("Ansel session ended"));
+	}
+
+	void CaptureStarted(EAnselCaptureType CaptureType)
+	{
+		EmitTransition(ETransition::CaptureStarted, CaptureType);
+		TRACE_BOOKMARK(TEXT("Ansel capture started (%s)"), *StaticEnum<EAnselCaptureType>()->GetNameStringByValue(int64(CaptureType)));
+	}
+
+	void CaptureEnded(EAnselCaptureType CaptureType)
+	{
+		EmitTransition(ETransition::CaptureEnded, CaptureType);
+		TRACE_BOOKMARK(TEXT("Ansel capture ended"));
+	}
+
+	void CaptureTile(uint32 TileIndex, float ProjectionOffsetX, float ProjectionOffsetY)
+	{
+		UE_TRACE_LOG(Ansel, CaptureTile, AnselChannel)
+			<< CaptureTile.Cycle(FPlatformTime::Cycles64())
+			<< CaptureTile.TileIndex(TileIndex)
+			<< CaptureTile.ProjectionOffsetX(ProjectionOffsetX)
+			<< CaptureTile.ProjectionOffsetY(ProjectionOffsetY);
+	}
+}
@@ -0,0 +1,24 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "AnselFunctionLibrary.h"
+
+// enable with -trace=cpu,AnselChannel (or Trace.Enable AnselChannel) to see the plugin's work in Insights
+UE_TRACE_CHANNEL_EXTERN(AnselChannel)
+
+#define ANSEL_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Name, AnselChannel)
+
+namespace AnselTrace
+{
+	void SessionStarted();
+	void SessionEnded();
+	void CaptureStarted(EAnselCaptureType CaptureType);
+	void CaptureEnded(EAnselCaptureType CaptureType);
+
+	/** One frame of a multi-part capture, i.e. one tile or one view of a panorama */
+	void CaptureTile(uint32 TileIndex, float ProjectionOffsetX, float ProjectionOffsetY);
+}
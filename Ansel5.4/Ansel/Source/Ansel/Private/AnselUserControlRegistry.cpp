@@ -0,0 +1,445 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselUserControlRegistry.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Engine/Scene.h"
+#include "UObject/UnrealType.h"
+#include "AnselTrace.h"
+#include "AnselMath.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogAnselUserControls, Log, All);
+
+static const TCHAR* AnselUserControlsSection = TEXT("Ansel.UserControls");
+
+const char* FAnselLabelArena::Intern(const FString& Label)
+{
+	if (const char** Existing = Interned.Find(Label))
+	{
+		return *Existing;
+	}
+
+	FTCHARToUTF8 Utf8(*Label);
+	const int32 Size = Utf8.Length() + 1;
+	if (BlockUsed + Size > BlockSize)
+	{
+		// oversized labels get a block of their own
+		Blocks.Emplace(MakeUnique<ANSICHAR[]>(FMath::Max(Size, BlockSize)));
+		BlockUsed = 0;
+	}
+
+	ANSICHAR* Dest = Blocks.Last().Get() + BlockUsed;
+	FMemory::Memcpy(Dest, Utf8.Get(), Utf8.Length());
+	Dest[Utf8.Length()] = 0;
+	BlockUsed = (Size > BlockSize) ? BlockSize : BlockUsed + Size;
+
+	Interned.Add(Label, Dest);
+	return Dest;
+}
+
+FAnselUserControlRegistry& FAnselUserControlRegistry::Get()
+{
+	static FAnselUserControlRegistry Registry;
+	return Registry;
+}
+
+void FAnselUserControlRegistry::Register(const FAnselUserControlDesc& Desc)
+{
+	check(IsInGameThread());
+
+	int32 Index;
+	if (const int32* ExistingIndex = EntryIndexByName.Find(Desc.Name))
+	{
+		Index = *ExistingIndex;
+		RemoveFromOverlay(Index + 1, *Entries[Index]);
+		Entries[Index] = MakeUnique<FEntry>();
+	}
+	else
+	{
+		Index = Entries.Emplace(MakeUnique<FEntry>());
+		EntryIndexByName.Add(Desc.Name, Index);
+	}
+
+	FEntry& Entry = *Entries[Index];
+	Entry.Desc = Desc;
+	Entry.LabelUtf8 = Labels.Intern(Desc.Label.ToString());
+
+	RebuildPostProcessOverrides();
+}
+
+void FAnselUserControlRegistry::Unregister(FName Name)
+{
+	check(IsInGameThread());
+
+	int32 Index;
+	if (EntryIndexByName.RemoveAndCopyValue(Name, Index))
+	{
+		RemoveFromOverlay(Index + 1, *Entries[Index]);
+		Entries[Index].Reset();
+		RebuildPostProcessOverrides();
+	}
+}
+
+// splits "(Key=Value, Key="Quoted, Value", ...)" into its fields
+static void ParseControlFields(const FString& Line, TMap<FString, FString>& OutFields)
+{
+	FString Body = Line.TrimStartAndEnd();
+	Body.RemoveFromStart(TEXT("("));
+	Body.RemoveFromEnd(TEXT(")"));
+
+	FString Field;
+	bool bInQuotes = false;
+	auto FlushField = [&OutFields, &Field]()
+	{
+		FString Key, Value;
+		if (Field.Split(TEXT("="), &Key, &Value))
+		{
+			Value.TrimStartAndEndInline();
+			Value.TrimQuotesInline();
+			OutFields.Add(Key.TrimStartAndEnd(), Value);
+		}
+		Field.Reset();
+	};
+
+	for (TCHAR Char : Body)
+	{
+		if (Char == TEXT('"'))
+		{
+			bInQuotes = !bInQuotes;
+		}
+		if (Char == TEXT(',') && !bInQuotes)
+		{
+			FlushField();
+		}
+		else
+		{
+			Field.AppendChar(Char);
+		}
+	}
+	FlushField();
+}
+
+void FAnselUserControlRegistry::LoadFromConfig(const FString& ConfigFilename)
+{
+	TArray<FString> Lines;
+	GConfig->GetArray(AnselUserControlsSection, TEXT("Controls"), Lines, ConfigFilename);
+
+	for (const FString& Line : Lines)
+	{
+		TMap<FString, FString> Fields;
+		ParseControlFields(Line, Fields);
+		auto GetField = [&Fields](const TCHAR* Key, const TCHAR* Default)
+		{
+			const FString* Value = Fields.Find(Key);
+			return Value ? *Value : FString(Default);
+		};
+
+		const FString* Name = Fields.Find(TEXT("Name"));
+		const FString* TargetName = Fields.Find(TEXT("TargetName"));
+		if (!Name || !TargetName)
+		{
+			UE_LOG(LogAnselUserControls, Warning, TEXT("Ignoring control without Name and TargetName: %s"), *Line);
+			continue;
+		}
+
+		FAnselUserControlDesc Desc;
+		Desc.Name = FName(**Name);
+		Desc.TargetName = FName(**TargetName);
+		Desc.Label = FText::FromString(GetField(TEXT("Label"), **Name));
+		Desc.Type = GetField(TEXT("Type"), TEXT("")).Equals(TEXT("Bool"), ESearchCase::IgnoreCase) ? EAnselUserControlType::Bool : EAnselUserControlType::Slider;
+		Desc.Target = GetField(TEXT("Target"), TEXT("")).Equals(TEXT("ConsoleVariable"), ESearchCase::IgnoreCase) ? EAnselUserControlTarget::ConsoleVariable : EAnselUserControlTarget::PostProcess;
+		LexFromString(Desc.Min, *GetField(TEXT("Min"), TEXT("0")));
+		LexFromString(Desc.Max, *GetField(TEXT("Max"), TEXT("1")));
+		LexFromString(Desc.EffectGroup, *GetField(TEXT("EffectGroup"), TEXT("-1")));
+
+		TArray<FString> RequiresActive;
+		GetField(TEXT("RequiresActive"), TEXT("")).ParseIntoArray(RequiresActive, TEXT("|"));
+		for (const FString& PropertyName : RequiresActive)
+		{
+			Desc.RequiresActive.Add(FName(*PropertyName));
+		}
+
+		Register(Desc);
+	}
+
+	if (Lines.Num() > 0)
+	{
+		UE_LOG(LogAnselUserControls, Log, TEXT("Registered %d Ansel user controls from %s"), Lines.Num(), *ConfigFilename);
+	}
+}
+
+FAnselUserControlRegistry::FEntry* FAnselUserControlRegistry::FindEntry(uint32 UserControlId) const
+{
+	const int32 Index = int32(UserControlId) - 1;
+	return Entries.IsValidIndex(Index) ? Entries[Index].Get() : nullptr;
+}
+
+bool FAnselUserControlRegistry::ResolveBinding(FEntry& Entry)
+{
+	if (Entry.bBindingResolved)
+	{
+		return true;
+	}
+
+	const FAnselUserControlDesc& Desc = Entry.Desc;
+	switch (Desc.Target)
+	{
+	case EAnselUserControlTarget::PostProcess:
+	{
+		// resolved lazily since the module loads long before the engine's reflection data is usable
+		UScriptStruct* PPStruct = FPostProcessSettings::StaticStruct();
+		Entry.Property = PPStruct->FindPropertyByName(Desc.TargetName);
+		Entry.OverrideProperty = CastField<FBoolProperty>(PPStruct->FindPropertyByName(FName(*(TEXT("bOverride_") + Desc.TargetName.ToString()))));
+		const bool bValidType = CastField<FFloatProperty>(Entry.Property) || (Desc.Type == EAnselUserControlType::Bool && CastField<FBoolProperty>(Entry.Property));
+		Entry.bBindingResolved = bValidType;
+		break;
+	}
+	case EAnselUserControlTarget::ConsoleVariable:
+		Entry.bBindingResolved = IConsoleManager::Get().FindConsoleVariable(*Desc.TargetName.ToString()) != nullptr;
+		break;
+	case EAnselUserControlTarget::Callback:
+		Entry.bBindingResolved = !!Desc.OnValueChanged;
+		break;
+	}
+
+	if (!Entry.bBindingResolved)
+	{
+		UE_LOG(LogAnselUserControls, Warning, TEXT("Ansel control %s: can't bind to %s"), *Desc.Name.ToString(), *Desc.TargetName.ToString());
+	}
+	return Entry.bBindingResolved;
+}
+
+bool FAnselUserControlRegistry::IsRelevant(FEntry& Entry, const FPostProcessSettings& SessionStartSettings, const TStaticBitArray<256>& EffectUIAllowed)
+{
+	const FAnselUserControlDesc& Desc = Entry.Desc;
+	if (Desc.EffectGroup != INDEX_NONE &&
+		(Desc.EffectGroup < 0 || Desc.EffectGroup >= int32(EffectUIAllowed.Num()) || !EffectUIAllowed[Desc.EffectGroup]))
+	{
+		return false;
+	}
+
+	for (const FName& PropertyName : Desc.RequiresActive)
+	{
+		if (const FFloatProperty* Property = CastField<FFloatProperty>(FPostProcessSettings::StaticStruct()->FindPropertyByName(PropertyName)))
+		{
+			if (Property->GetPropertyValue_InContainer(&SessionStartSettings) <= 0.f)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+float FAnselUserControlRegistry::GetCurrentTargetValue(const FEntry& Entry, const FPostProcessSettings& Settings) const
+{
+	switch (Entry.Desc.Target)
+	{
+	case EAnselUserControlTarget::PostProcess:
+		if (const FFloatProperty* FloatProperty = CastField<FFloatProperty>(Entry.Property))
+		{
+			return FloatProperty->GetPropertyValue_InContainer(&Settings);
+		}
+		return CastFieldChecked<FBoolProperty>(Entry.Property)->GetPropertyValue_InContainer(&Settings) ? 1.f : 0.f;
+	case EAnselUserControlTarget::ConsoleVariable:
+		return IConsoleManager::Get().FindConsoleVariable(*Entry.Desc.TargetName.ToString())->GetFloat();
+	default:
+		return Entry.Desc.DefaultValue;
+	}
+}
+
+void FAnselUserControlRegistry::AddToOverlay(uint32 UserControlId, FEntry& Entry)
+{
+	ansel::UserControlDesc Desc;
+	Desc.labelUtf8 = Entry.LabelUtf8;
+	Desc.callback = AnselUserControlCallback;
+	Desc.info.userControlId = UserControlId;
+	Desc.info.userPointer = this;
+	if (Entry.Desc.Type == EAnselUserControlType::Slider)
+	{
+		Desc.info.userControlType = ansel::kUserControlSlider;
+		Desc.info.value = &Entry.Value.float_val;
+	}
+	else
+	{
+		Desc.info.userControlType = ansel::kUserControlBoolean;
+		Desc.info.value = &Entry.Value.bool_val;
+	}
+
+	ANSEL_TRACE_SCOPE(AnselSDK_addUserControl);
+	ansel::UserControlStatus status = ansel::addUserControl(Desc);
+	UE_LOG(LogAnselUserControls, Log, TEXT("control#%u (%s) status=%d"), UserControlId, *Entry.Desc.Name.ToString(), (int)status);
+	Entry.bInOverlay = (status == ansel::kUserControlOk || status == ansel::kUserControlIdAlreadyExists);
+}
+
+void FAnselUserControlRegistry::RemoveFromOverlay(uint32 UserControlId, FEntry& Entry)
+{
+	if (Entry.bInOverlay)
+	{
+		ANSEL_TRACE_SCOPE(AnselSDK_removeUserControl);
+		ansel::removeUserControl(UserControlId);
+		Entry.bInOverlay = false;
+	}
+}
+
+void FAnselUserControlRegistry::SyncForSession(const FPostProcessSettings& SessionStartSettings, const TStaticBitArray<256>& EffectUIAllowed, TFunctionRef<void(const TCHAR*, float)> SetCVar)
+{
+	check(IsInGameThread());
+
+	// anything still queued belongs to the previous session
+	ControlEvents.Empty();
+
+	for (int32 Index = 0; Index < Entries.Num(); ++Index)
+	{
+		FEntry* Entry = Entries[Index].Get();
+		if (!Entry)
+		{
+			continue;
+		}
+
+		const uint32 UserControlId = Index + 1;
+		if (!ResolveBinding(*Entry) || !IsRelevant(*Entry, SessionStartSettings, EffectUIAllowed))
+		{
+			RemoveFromOverlay(UserControlId, *Entry);
+			continue;
+		}
+
+		// controls start out showing their effect's current value
+		const float CurrentValue = GetCurrentTargetValue(*Entry, SessionStartSettings);
+		FControlValue NewValue;
+		if (Entry->Desc.Type == EAnselUserControlType::Slider)
+		{
+			NewValue.float_val = AnselMath::ValueToSlider(CurrentValue, Entry->Desc.Min, Entry->Desc.Max);
+		}
+		else
+		{
+			NewValue.bool_val = CurrentValue != 0.f;
+		}
+
+		if (!Entry->bInOverlay)
+		{
+			Entry->Value = NewValue;
+			AddToOverlay(UserControlId, *Entry);
+		}
+		else if (Entry->Desc.Type == EAnselUserControlType::Slider ? Entry->Value.float_val != NewValue.float_val : Entry->Value.bool_val != NewValue.bool_val)
+		{
+			Entry->Value = NewValue;
+			ANSEL_TRACE_SCOPE(AnselSDK_setUserControlValue);
+			ansel::setUserControlValue(UserControlId, Entry->Desc.Type == EAnselUserControlType::Slider ? (const void*)&Entry->Value.float_val : (const void*)&Entry->Value.bool_val);
+		}
+
+		if (Entry->Desc.Target == EAnselUserControlTarget::Callback)
+		{
+			ApplyValue(*Entry, SetCVar);
+		}
+	}
+
+	RebuildPostProcessOverrides();
+}
+
+bool FAnselUserControlRegistry::ConsumeControlEvents(TFunctionRef<void(const TCHAR*, float)> SetCVar)
+{
+	bool bChanged = false;
+
+	FControlEvent Event;
+	while (ControlEvents.Dequeue(Event))
+	{
+		FEntry* Entry = FindEntry(Event.UserControlId);
+		if (Entry && Entry->bInOverlay)
+		{
+			Entry->Value = Event.Value;
+			ApplyValue(*Entry, SetCVar);
+			bChanged = true;
+		}
+	}
+
+	if (bChanged)
+	{
+		RebuildPostProcessOverrides();
+	}
+	return bChanged;
+}
+
+void FAnselUserControlRegistry::ApplyValue(FEntry& Entry, TFunctionRef<void(const TCHAR*, float)> SetCVar)
+{
+	const FAnselUserControlDesc& Desc = Entry.Desc;
+	const float Value = (Desc.Type == EAnselUserControlType::Slider) ? AnselMath::SliderToValue(Entry.Value.float_val, Desc.Min, Desc.Max) : (Entry.Value.bool_val ? 1.f : 0.f);
+
+	switch (Desc.Target)
+	{
+	case EAnselUserControlTarget::ConsoleVariable:
+		SetCVar(*Desc.TargetName.ToString(), Value);
+		break;
+	case EAnselUserControlTarget::Callback:
+		Desc.OnValueChanged(Value);
+		break;
+	default:
+		break; // postprocessing is patched every frame from PostProcessOverrides
+	}
+}
+
+void FAnselUserControlRegistry::RebuildPostProcessOverrides()
+{
+	PostProcessOverrides.Reset();
+	for (const TUniquePtr<FEntry>& Entry : Entries)
+	{
+		if (Entry && Entry->bInOverlay && Entry->Desc.Target == EAnselUserControlTarget::PostProcess)
+		{
+			FPostProcessOverride& Override = PostProcessOverrides.AddDefaulted_GetRef();
+			Override.Entry = Entry.Get();
+			Override.Value = (Entry->Desc.Type == EAnselUserControlType::Slider) ? AnselMath::SliderToValue(Entry->Value.float_val, Entry->Desc.Min, Entry->Desc.Max) : (Entry->Value.bool_val ? 1.f : 0.f);
+		}
+	}
+}
+
+void FAnselUserControlRegistry::ApplyPostProcessOverrides(FPostProcessSettings& InOutPPSettings) const
+{
+	for (const FPostProcessOverride& Override : PostProcessOverrides)
+	{
+		if (const FFloatProperty* FloatProperty = CastField<FFloatProperty>(Override.Entry->Property))
+		{
+			FloatProperty->SetPropertyValue_InContainer(&InOutPPSettings, Override.Value);
+		}
+		else
+		{
+			CastFieldChecked<FBoolProperty>(Override.Entry->Property)->SetPropertyValue_InContainer(&InOutPPSettings, Override.Value != 0.f);
+		}
+
+		if (Override.Entry->OverrideProperty)
+		{
+			Override.Entry->OverrideProperty->SetPropertyValue_InContainer(&InOutPPSettings, true);
+		}
+	}
+}
+
+void FAnselUserControlRegistry::RemoveAllFromOverlay()
+{
+	for (int32 Index = 0; Index < Entries.Num(); ++Index)
+	{
+		if (Entries[Index])
+		{
+			RemoveFromOverlay(Index + 1, *Entries[Index]);
+		}
+	}
+	PostProcessOverrides.Reset();
+	ControlEvents.Empty();
+}
+
+void FAnselUserControlRegistry::AnselUserControlCallback(const ansel::UserControlInfo& info)
+{
+	FAnselUserControlRegistry* Registry = static_cast<FAnselUserControlRegistry*>(info.userPointer);
+	check(Registry != nullptr);
+
+	FControlEvent Event;
+	Event.UserControlId = info.userControlId;
+	if (info.userControlType == ansel::kUserControlSlider)
+	{
+		Event.Value.float_val = *(const float*)info.value;
+	}
+	else
+	{
+		Event.Value.bool_val = *(const bool*)info.value;
+	}
+	Registry->ControlEvents.Enqueue(Event);
+}
@@ -0,0 +1,116 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Containers/StaticBitArray.h"
+#include "AnselUserControls.h"
+#include <AnselSDK.h>
+
+struct FPostProcessSettings;
+class FProperty;
+class FBoolProperty;
+
+/**
+ * Stable storage for the UTF-8 labels handed to the Ansel SDK.  Labels are interned into fixed-size
+ * blocks which never move, so the pointers stay valid for as long as the arena lives.
+ */
+class FAnselLabelArena
+{
+public:
+	const char* Intern(const FString& Label);
+
+private:
+	static constexpr int32 BlockSize = 4096;
+
+	TArray<TUniquePtr<ANSICHAR[]>> Blocks;
+	int32 BlockUsed = BlockSize;
+	TMap<FString, const char*> Interned;
+};
+
+/**
+ * Every control which can appear in the 'Game Settings' part of the Ansel overlay, whether built in,
+ * registered by game code or declared in Game.ini.  A control's SDK id is its slot in Entries plus
+ * one (0 means 'unused'), so callbacks find their control in O(1).  Must only be used from the game
+ * thread, apart from the SDK callback which just queues the change.
+ */
+class FAnselUserControlRegistry
+{
+public:
+	static FAnselUserControlRegistry& Get();
+
+	void Register(const FAnselUserControlDesc& Desc);
+	void Unregister(FName Name);
+
+	/** Registers the controls declared by +Controls= lines in the [Ansel.UserControls] section of the given ini */
+	void LoadFromConfig(const FString& ConfigFilename);
+
+	/**
+	 * Brings the overlay in line with the controls relevant to a new session, given the postprocessing at
+	 * session start.  Only controls whose visibility changed are added to or removed from the overlay.
+	 */
+	void SyncForSession(const FPostProcessSettings& SessionStartSettings, const TStaticBitArray<256>& EffectUIAllowed, TFunctionRef<void(const TCHAR*, float)> SetCVar);
+
+	/** Applies changes the overlay has queued since the last call; returns whether anything changed */
+	bool ConsumeControlEvents(TFunctionRef<void(const TCHAR*, float)> SetCVar);
+
+	/** Patches the postprocessing members driven by the controls currently in the overlay */
+	void ApplyPostProcessOverrides(FPostProcessSettings& InOutPPSettings) const;
+
+	/** Takes every control out of the overlay, e.g. before the SDK goes away */
+	void RemoveAllFromOverlay();
+
+private:
+	union FControlValue
+	{
+		bool bool_val;
+		float float_val;
+	};
+
+	struct FEntry
+	{
+		FAnselUserControlDesc Desc;
+		const char* LabelUtf8 = nullptr;
+
+		FProperty* Property = nullptr;
+		FBoolProperty* OverrideProperty = nullptr;
+		bool bBindingResolved = false;
+
+		bool bInOverlay = false;
+		FControlValue Value; // the SDK reads the initial value from here, so entries must not move
+	};
+
+	struct FControlEvent
+	{
+		uint32 UserControlId;
+		FControlValue Value;
+	};
+
+	struct FPostProcessOverride
+	{
+		const FEntry* Entry;
+		float Value; // slider value already mapped into [Min,Max], or 0/1 for bools
+	};
+
+	static void AnselUserControlCallback(const ansel::UserControlInfo& info);
+
+	FEntry* FindEntry(uint32 UserControlId) const;
+	bool ResolveBinding(FEntry& Entry);
+	bool IsRelevant(FEntry& Entry, const FPostProcessSettings& SessionStartSettings, const TStaticBitArray<256>& EffectUIAllowed);
+	float GetCurrentTargetValue(const FEntry& Entry, const FPostProcessSettings& Settings) const;
+	void AddToOverlay(uint32 UserControlId, FEntry& Entry);
+	void RemoveFromOverlay(uint32 UserControlId, FEntry& Entry);
+	void ApplyValue(FEntry& Entry, TFunctionRef<void(const TCHAR*, float)> SetCVar);
+	void RebuildPostProcessOverrides();
+
+	/** Indexed by SDK id - 1; unregistered slots are left empty rather than reused */
+	TArray<TUniquePtr<FEntry>> Entries;
+	TMap<FName, int32> EntryIndexByName;
+
+	FAnselLabelArena Labels;
+
+	TQueue<FControlEvent, EQueueMode::Mpsc> ControlEvents;
+
+	TArray<FPostProcessOverride> PostProcessOverrides;
+};
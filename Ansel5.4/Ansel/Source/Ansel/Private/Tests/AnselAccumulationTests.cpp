@@ -0,0 +1,160 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselAccumulation.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselTileAllocatorVarianceMapTest, "Plugins.Ansel.Accumulation.AllocatorVarianceMap", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselTileAllocatorVarianceMapTest::RunTest(const FString& Parameters)
+{
+	// made-up noise for four tiles: clean sky, a surface whose noise falls off as 1 / sqrt(samples) and
+	// gets to the target at 16 samples, foliage which never does, and a tile that starts clean
+	FAnselAccumulationSettings Settings;
+	Settings.MaxSamples = 32;
+	Settings.NoiseTarget = 1.f;
+
+	FAnselTileSampleAllocator Allocator;
+	Allocator.Reset(4, Settings);
+	int32 NumSamples = 0;
+	while (!Allocator.IsFinished())
+	{
+		++NumSamples;
+		const float TileNoise[] = { 0.2f, 4.f / FMath::Sqrt(float(NumSamples)), 6.f, 0.f };
+		Allocator.AddSample(TileNoise);
+	}
+
+	// a variance needs two samples, so even the clean tiles take two; the foliage keeps every frame coming
+	TestEqual(TEXT("Frames rendered"), NumSamples, Settings.MaxSamples);
+	TestEqual(TEXT("Sky samples"), Allocator.GetTileSamples(0), 2);
+	TestEqual(TEXT("Surface samples"), Allocator.GetTileSamples(1), 16);
+	TestEqual(TEXT("Foliage samples"), Allocator.GetTileSamples(2), Settings.MaxSamples);
+	TestEqual(TEXT("Clean tile samples"), Allocator.GetTileSamples(3), 2);
+	TestFalse(TEXT("Sky is done"), Allocator.IsTileActive(0));
+	TestTrue(TEXT("Foliage never converged"), Allocator.IsTileActive(2));
+
+	// tiles converging early saves nothing while another still needs frames
+	FAnselAccumulationStats Stats = Allocator.GetStats();
+	TestEqual(TEXT("Stats samples"), Stats.NumSamples, Settings.MaxSamples);
+	TestEqual(TEXT("Fixed samples"), Stats.NumFixedSamples, Settings.MaxSamples);
+
+	// once every tile is clean the frames stop early, and that's the saving
+	Allocator.Reset(2, Settings);
+	NumSamples = 0;
+	while (!Allocator.IsFinished())
+	{
+		++NumSamples;
+		const float TileNoise[] = { 0.5f, 2.f / float(NumSamples) };
+		Allocator.AddSample(TileNoise);
+	}
+	TestEqual(TEXT("Frames rendered when everything converges"), NumSamples, 2);
+	Stats = Allocator.GetStats();
+	TestTrue(TEXT("Saving is in frames skipped"), Stats.NumSamples == 2 && Stats.NumFixedSamples == Settings.MaxSamples);
+
+	// the slowest tile of a made-up variance map sets the frame count: noise falling off as
+	// Sigma / sqrt(samples) reaches the target at (Sigma / target)^2 samples
+	const float Sigmas[] = { 1.f, 2.f, 3.f, 4.f, 5.f, 6.f };
+	constexpr int32 NumSigmas = UE_ARRAY_COUNT(Sigmas);
+	Allocator.Reset(NumSigmas, Settings);
+	NumSamples = 0;
+	while (!Allocator.IsFinished())
+	{
+		++NumSamples;
+		float TileNoise[NumSigmas];
+		for (int32 Tile = 0; Tile < NumSigmas; ++Tile)
+		{
+			TileNoise[Tile] = Sigmas[Tile] / FMath::Sqrt(float(NumSamples));
+		}
+		Allocator.AddSample(TileNoise);
+	}
+	for (int32 Tile = 0; Tile < NumSigmas; ++Tile)
+	{
+		const int32 Expected = FMath::Clamp(FMath::CeilToInt32(FMath::Square(Sigmas[Tile] / Settings.NoiseTarget)), 2, Settings.MaxSamples);
+		TestEqual(FString::Printf(TEXT("Tile with sigma %.0f converges"), Sigmas[Tile]), Allocator.GetTileSamples(Tile), Expected);
+	}
+	TestEqual(TEXT("Variance map frames"), NumSamples, 32);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselFrameAccumulatorTest, "Plugins.Ansel.Accumulation.FrameAccumulator", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselFrameAccumulatorTest::RunTest(const FString& Parameters)
+{
+	// the tiles don't divide the frame, so the part tiles on the right and bottom are covered too
+	const FIntPoint Size(150, 70);
+
+	FAnselAccumulationSettings Settings;
+	Settings.MaxSamples = 8;
+	Settings.NoiseTarget = 0.5f;
+
+	// a still frame is clean after two samples and comes out as it went in
+	FAnselFrameAccumulator Accumulator;
+	Accumulator.Reset(Settings);
+	TArray<FColor> Frame;
+	Frame.Init(FColor(40, 120, 200, 255), Size.X * Size.Y);
+	while (!Accumulator.IsConverged())
+	{
+		Accumulator.AddSample(Frame.GetData(), Size);
+	}
+	TestEqual(TEXT("Still frame samples"), Accumulator.GetNumSamples(), 2);
+	TestEqual(TEXT("Still frame noise"), Accumulator.GetNoise(), 0.f);
+
+	TArray<FColor> Resolved;
+	Accumulator.Resolve(Resolved);
+	TestEqual(TEXT("Resolved size"), Resolved.Num(), Frame.Num());
+	auto IsNear = [](const FColor& A, const FColor& B) { return FMath::Abs(A.R - B.R) <= 1 && FMath::Abs(A.G - B.G) <= 1 && FMath::Abs(A.B - B.B) <= 1; };
+	TestTrue(TEXT("Still frame unchanged"), Resolved.Num() == Frame.Num() && IsNear(Resolved[0], Frame[0]) && IsNear(Resolved.Last(), Frame.Last()));
+
+	// frames of any other size are left out
+	AddExpectedError(TEXT("Ignoring a 10x10 sample"), EAutomationExpectedErrorFlags::Contains, 1);
+	TArray<FColor> Smaller;
+	Smaller.Init(FColor::White, 10 * 10);
+	Accumulator.AddSample(Smaller.GetData(), FIntPoint(10, 10));
+	TestEqual(TEXT("Mismatched frame ignored"), Accumulator.GetNumSamples(), 2);
+
+	// a frame flickering between two levels averages to their mean in linear light and never gets clean
+	Settings.NoiseTarget = 0.01f;
+	Accumulator.Reset(Settings);
+	const FColor Dark(64, 64, 64, 255);
+	const FColor Bright(192, 192, 192, 255);
+	for (int32 Sample = 0; Sample < Settings.MaxSamples; ++Sample)
+	{
+		Frame.Init((Sample & 1) ? Bright : Dark, Size.X * Size.Y);
+		Accumulator.AddSample(Frame.GetData(), Size);
+	}
+	TestTrue(TEXT("Flicker used every sample"), Accumulator.IsConverged() && Accumulator.GetNumSamples() == Settings.MaxSamples);
+	TestTrue(TEXT("Flicker is noisy"), Accumulator.GetNoise() > Settings.NoiseTarget);
+
+	Accumulator.Resolve(Resolved);
+	const FColor Expected = ((FLinearColor::FromSRGBColor(Dark) + FLinearColor::FromSRGBColor(Bright)) * 0.5f).ToFColorSRGB();
+	TestTrue(FString::Printf(TEXT("Flicker averages to %s (is %s)"), *Expected.ToString(), *Resolved.Last().ToString()), IsNear(Resolved.Last(), Expected));
+
+	// the left column of tiles is clean after two still samples, but the flickering right keeps frames
+	// coming, and every one of them is rendered whole, so the left goes on averaging them all
+	Accumulator.Reset(Settings);
+	const FColor Before(100, 100, 100, 255);
+	const FColor After(110, 110, 110, 255);
+	for (int32 Sample = 0; Sample < Settings.MaxSamples; ++Sample)
+	{
+		for (int32 Y = 0; Y < Size.Y; ++Y)
+		{
+			for (int32 X = 0; X < Size.X; ++X)
+			{
+				Frame[Y * Size.X + X] = X < 64 ? (Sample < 2 ? Before : After) : ((Sample & 1) ? Bright : Dark);
+			}
+		}
+		Accumulator.AddSample(Frame.GetData(), Size);
+	}
+	TestEqual(TEXT("Split frame samples"), Accumulator.GetNumSamples(), Settings.MaxSamples);
+
+	Accumulator.Resolve(Resolved);
+	const FColor ExpectedLeft = ((FLinearColor::FromSRGBColor(Before) * 2.f + FLinearColor::FromSRGBColor(After) * float(Settings.MaxSamples - 2)) / float(Settings.MaxSamples)).ToFColorSRGB();
+	TestTrue(FString::Printf(TEXT("Converged tile averages every frame to %s (is %s)"), *ExpectedLeft.ToString(), *Resolved[0].ToString()), IsNear(Resolved[0], ExpectedLeft));
+	TestTrue(TEXT("Flickering tile averages every frame"), IsNear(Resolved.Last(), Expected));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,225 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselBatchCapture.h"
+#include "AnselTestBatchHost.h"
+#include "Dom/JsonObject.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static TArray<FString> GetReportStatuses(const FString& Report)
+{
+	TArray<FString> Statuses;
+	TSharedPtr<FJsonObject> Root;
+	if (FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Report), Root) && Root.IsValid())
+	{
+		for (const TSharedPtr<FJsonValue>& Shot : Root->GetArrayField(TEXT("Shots")))
+		{
+			Statuses.Add(Shot->AsObject()->GetStringField(TEXT("Status")));
+		}
+	}
+	return Statuses;
+}
+
+static TArray<double> GetReportNumbers(const FString& Report, const TCHAR* Field)
+{
+	TArray<double> Numbers;
+	TSharedPtr<FJsonObject> Root;
+	if (FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Report), Root) && Root.IsValid())
+	{
+		for (const TSharedPtr<FJsonValue>& Shot : Root->GetArrayField(TEXT("Shots")))
+		{
+			Numbers.Add(Shot->AsObject()->GetNumberField(Field));
+		}
+	}
+	return Numbers;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselBatchManifestParseTest, "Plugins.Ansel.Batch.ManifestParse", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselBatchManifestParseTest::RunTest(const FString& Parameters)
+{
+	FAnselBatchManifest Manifest;
+	FString Error;
+	const bool bParsed = FAnselBatchManifest::Parse(TEXT(R"({ "OutputDirectory": "Out", "FrameRate": 30, "Seed": 7,
+		"Shots": [ { "Name": "Hero", "Location": [1, 2, 3], "Rotation": [-10, 90, 0], "FOV": 60, "CaptureType": "SuperResolution",
+		             "Resolution": [1920, 1080], "Quality": "Low", "Supersample": 2, "Samples": 8, "NoiseTarget": 0.5, "SettleFrames": 4 },
+		           { "Location": [0, 0, 0], "Format": "EXR" } ] })"), Manifest, Error);
+	TestTrue(FString::Printf(TEXT("Manifest parses (%s)"), *Error), bParsed);
+	if (!bParsed)
+	{
+		return true;
+	}
+
+	TestEqual(TEXT("OutputDirectory"), Manifest.OutputDirectory, FString(TEXT("Out")));
+	TestEqual(TEXT("FrameRate"), Manifest.FrameRate, 30.);
+	TestEqual(TEXT("Seed"), Manifest.Seed, 7);
+	TestEqual(TEXT("Shot count"), Manifest.Shots.Num(), 2);
+
+	const FAnselBatchShot& Hero = Manifest.Shots[0];
+	TestEqual(TEXT("Name"), Hero.Name, FString(TEXT("Hero")));
+	TestEqual(TEXT("Index"), Hero.Index, 0);
+	TestEqual(TEXT("Location"), Hero.Location, FVector(1., 2., 3.));
+	TestEqual(TEXT("Rotation"), Hero.Rotation, FRotator(-10., 90., 0.));
+	TestEqual(TEXT("FOV"), Hero.FOV, 60.f);
+	TestTrue(TEXT("CaptureType"), Hero.CaptureType == EAnselCaptureType::SuperResolution);
+	TestTrue(TEXT("Resolution"), Hero.Resolution == FIntPoint(1920, 1080));
+	TestFalse(TEXT("Quality"), Hero.bHighQuality);
+	TestEqual(TEXT("Supersample"), Hero.Supersample, 2);
+	TestEqual(TEXT("Samples"), Hero.Accumulation.MaxSamples, 8);
+	TestEqual(TEXT("NoiseTarget"), Hero.Accumulation.NoiseTarget, 0.5f);
+	TestEqual(TEXT("SettleFrames"), Hero.SettleFrames, 4);
+
+	const FAnselBatchShot& Unnamed = Manifest.Shots[1];
+	TestEqual(TEXT("Default name"), Unnamed.Name, FString(TEXT("Shot001")));
+	TestEqual(TEXT("Sequence time"), Unnamed.SequenceSeconds, 1. / 30.);
+	TestTrue(TEXT("EXR"), Unnamed.bHDR);
+	TestEqual(TEXT("Default settle frames"), Unnamed.SettleFrames, -1);
+
+	// each of these has one thing wrong with it
+	const TCHAR* BadManifests[] =
+	{
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0] } )"),
+		TEXT(R"({ "Shots": [] })"),
+		TEXT(R"({ "Shots": [ { "Rotation": [0, 0, 0] } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0] } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "CaptureType": "Panorama" } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "Format": "TIFF" } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "Supersample": 0 } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "Resolution": [20000, 100] } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "Format": "EXR", "Supersample": 2 } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "Format": "EXR", "Samples": 4 } ] })"),
+		TEXT(R"({ "Shots": [ { "Location": [0, 0, 0], "NoiseTarget": -1 } ] })"),
+		TEXT(R"({ "FrameRate": -30, "Shots": [ { "Location": [0, 0, 0] } ] })"),
+		TEXT(R"({ "FrameSink": { "Slots": 4 }, "Shots": [ { "Location": [0, 0, 0], "Resolution": [64, 64] } ] })"),
+		TEXT(R"({ "FrameSink": { "Name": "Frames", "Policy": "Block" }, "Shots": [ { "Location": [0, 0, 0], "Resolution": [64, 64] } ] })"),
+		TEXT(R"({ "FrameSink": { "Name": "Frames" }, "Shots": [ { "Location": [0, 0, 0] } ] })"),
+		TEXT(R"({ "FrameSink": { "Name": "Frames" }, "Shots": [ { "Location": [0, 0, 0], "Resolution": [64, 64], "Format": "EXR" } ] })"),
+	};
+	for (const TCHAR* BadManifest : BadManifests)
+	{
+		FAnselBatchManifest Rejected;
+		FString RejectedError;
+		TestFalse(FString::Printf(TEXT("Rejects %s"), BadManifest), FAnselBatchManifest::Parse(BadManifest, Rejected, RejectedError));
+		TestFalse(FString::Printf(TEXT("Says why it rejects %s"), BadManifest), RejectedError.IsEmpty());
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselBatchSchedulerTest, "Plugins.Ansel.Batch.Scheduler", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselBatchSchedulerTest::RunTest(const FString& Parameters)
+{
+	FAnselBatchManifest Manifest;
+	FString Error;
+	FAnselBatchManifest::Parse(TEXT(R"({ "OutputDirectory": "Out", "Shots": [
+		{ "Name": "A", "Location": [0, 0, 0], "Resolution": [640, 480] },
+		{ "Name": "B", "Location": [100, 0, 0], "Resolution": [8192, 8192] },
+		{ "Name": "C", "Location": [200, 0, 0], "Resolution": [640, 480], "Format": "EXR" } ] })"), Manifest, Error);
+
+	FAnselTestBatchHost Host;
+	Host.MaxCaptureSize = 4096;
+	AddExpectedError(TEXT("Shot 'B': over budget"), EAutomationExpectedErrorFlags::Contains, 1);
+	FAnselBatchScheduler Scheduler(Manifest, Host);
+	TestTrue(TEXT("Batch finishes"), Host.Run(Scheduler));
+
+	TestTrue(TEXT("Every shot's view was set"), Host.ViewShots == TArray<FString>({ TEXT("A"), TEXT("B"), TEXT("C") }));
+	TestTrue(TEXT("Only affordable shots were captured"), Host.CapturedShots == TArray<FString>({ TEXT("A"), TEXT("C") }));
+	TestTrue(TEXT("Filenames follow the format"), Host.CapturedFilenames == TArray<FString>({ TEXT("Out/A.png"), TEXT("Out/C.exr") }));
+	TestTrue(TEXT("Statuses"), GetReportStatuses(Scheduler.BuildReport()) == TArray<FString>({ TEXT("Captured"), TEXT("OverBudget"), TEXT("Captured") }));
+	TestEqual(TEXT("No world steps without a FrameRate"), Host.WorldSteps, 0);
+
+	// a sequence steps the world up to each shot's frame
+	FAnselBatchManifest Sequence = Manifest;
+	Sequence.FrameRate = 24.;
+	Sequence.Shots[1].Resolution = FIntPoint(640, 480);
+	FAnselTestBatchHost SequenceHost;
+	FAnselBatchScheduler SequenceScheduler(Sequence, SequenceHost);
+	TestTrue(TEXT("Sequence finishes"), SequenceHost.Run(SequenceScheduler));
+	TestEqual(TEXT("World stepped to the last shot"), SequenceHost.WorldSteps, 2);
+	TestTrue(TEXT("Sequence statuses"), GetReportStatuses(SequenceScheduler.BuildReport()) == TArray<FString>({ TEXT("Captured"), TEXT("Captured"), TEXT("Captured") }));
+
+	// a frame the sink couldn't take doesn't count as captured
+	FAnselTestBatchHost DroppingHost;
+	DroppingHost.bDropCaptures = true;
+	FAnselBatchScheduler DroppingScheduler(Sequence, DroppingHost);
+	TestTrue(TEXT("Dropping batch finishes"), DroppingHost.Run(DroppingScheduler));
+	TestTrue(TEXT("Dropped statuses"), GetReportStatuses(DroppingScheduler.BuildReport()) == TArray<FString>({ TEXT("Dropped"), TEXT("Dropped"), TEXT("Dropped") }));
+
+	// a host which never gets ready, as without a working SDK, fails the batch rather than holding it up
+	FAnselTestBatchHost UnreadyHost;
+	UnreadyHost.bReady = false;
+	UnreadyHost.FrameSeconds = 1.;
+	AddExpectedError(TEXT("Not ready to capture"), EAutomationExpectedErrorFlags::Contains, 1);
+	FAnselBatchScheduler UnreadyScheduler(Sequence, UnreadyHost);
+	TestTrue(TEXT("Unready batch gives up"), UnreadyHost.Run(UnreadyScheduler, 1000));
+	TestTrue(TEXT("Unready statuses"), GetReportStatuses(UnreadyScheduler.BuildReport()) == TArray<FString>({ TEXT("HostNotReady"), TEXT("HostNotReady"), TEXT("HostNotReady") }));
+
+	// shots which differ only in location each get their own view, and each settles from scratch
+	FAnselBatchManifest Moved;
+	FAnselBatchManifest::Parse(TEXT(R"({ "OutputDirectory": "Out", "Shots": [
+		{ "Name": "Near", "Location": [0, 0, 100], "Rotation": [0, 90, 0], "SettleFrames": 3 },
+		{ "Name": "Far", "Location": [50000, 0, 100], "Rotation": [0, 90, 0], "SettleFrames": 3 } ] })"), Moved, Error);
+	FAnselTestBatchHost MovedHost;
+	FAnselBatchScheduler MovedScheduler(Moved, MovedHost);
+	TestTrue(TEXT("Moved batch finishes"), MovedHost.Run(MovedScheduler));
+	TestTrue(TEXT("Each shot's location was set"), MovedHost.ViewLocations == TArray<FVector>({ FVector(0., 0., 100.), FVector(50000., 0., 100.) }));
+	TestTrue(TEXT("Both shots captured"), MovedHost.CapturedShots == TArray<FString>({ TEXT("Near"), TEXT("Far") }));
+	const TArray<double> MovedSettleFrames = GetReportNumbers(MovedScheduler.BuildReport(), TEXT("SettleFrames"));
+	TestTrue(TEXT("Each shot waited out its settle frames"), MovedSettleFrames.Num() == 2 && MovedSettleFrames[0] >= 3. && MovedSettleFrames[1] >= 3.);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselBatchDeterminismTest, "Plugins.Ansel.Batch.Determinism", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselBatchDeterminismTest::RunTest(const FString& Parameters)
+{
+	FAnselBatchManifest Manifest;
+	FString Error;
+	FAnselBatchManifest::Parse(TEXT(R"({ "FrameRate": 24, "Seed": 1234, "Shots": [
+		{ "Location": [0, 0, 0] }, { "Location": [0, 0, 0] }, { "Location": [0, 0, 0] }, { "Location": [0, 0, 0] }, { "Location": [0, 0, 0] } ] })"), Manifest, Error);
+
+	// each run starts from whatever state startup left the streams in, which differs from run to run
+	auto RunSequence = [this, &Manifest](int32 StartupSeed, int32 StartupDraws, TArray<int32>& OutRands, TArray<float>& OutSRands)
+	{
+		FMath::RandInit(StartupSeed);
+		FMath::SRandInit(StartupSeed);
+		for (int32 Draw = 0; Draw < StartupDraws; ++Draw)
+		{
+			FMath::Rand();
+			FMath::SRand();
+		}
+
+		FAnselTestBatchHost Host;
+		FAnselBatchScheduler Scheduler(Manifest, Host);
+		TestTrue(TEXT("Sequence finishes"), Host.Run(Scheduler));
+		OutRands = Host.StepRands;
+		OutSRands = Host.StepSRands;
+	};
+
+	TArray<int32> FirstRands;
+	TArray<float> FirstSRands;
+	TArray<int32> SecondRands;
+	TArray<float> SecondSRands;
+	RunSequence(1, 3, FirstRands, FirstSRands);
+	RunSequence(99, 17, SecondRands, SecondSRands);
+
+	TestEqual(TEXT("A draw per step"), FirstRands.Num(), Manifest.Shots.Num() - 1);
+	TestTrue(TEXT("Rand draws match between runs"), FirstRands == SecondRands);
+	TestTrue(TEXT("SRand draws match between runs"), FirstSRands == SecondSRands);
+
+	// and it's the manifest's seed which decides them
+	Manifest.Seed = 4321;
+	TArray<int32> ReseededRands;
+	TArray<float> ReseededSRands;
+	RunSequence(1, 3, ReseededRands, ReseededSRands);
+	TestFalse(TEXT("Another seed draws differently"), FirstRands == ReseededRands && FirstSRands == ReseededSRands);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,113 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselBatchShards.h"
+#include "AnselBatchCapture.h"
+#include "AnselTestBatchHost.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** A shard of a batch run in-process: its own claim queue, stand-in host and scheduler, as a worker process has */
+struct FAnselTestShard
+{
+	FAnselTestShard(const FAnselBatchManifest& Manifest, const FString& ClaimDirectory, const FString& WorkerId)
+		: Queue(ClaimDirectory, WorkerId, Manifest.Shots.Num())
+		, Scheduler(Manifest, Host, &Queue)
+	{
+	}
+
+	FAnselBatchShardQueue Queue;
+	FAnselTestBatchHost Host;
+	FAnselBatchScheduler Scheduler;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselBatchShardsTest, "Plugins.Ansel.Batch.Shards", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselBatchShardsTest::RunTest(const FString& Parameters)
+{
+	FAnselBatchManifest Manifest;
+	FString Error;
+	FAnselBatchManifest::Parse(TEXT(R"({ "OutputDirectory": "Out", "Shots": [
+		{ "Name": "S0", "Location": [0, 0, 0] }, { "Name": "S1", "Location": [0, 0, 0] }, { "Name": "S2", "Location": [0, 0, 0] },
+		{ "Name": "S3", "Location": [0, 0, 0] }, { "Name": "S4", "Location": [0, 0, 0] }, { "Name": "S5", "Location": [0, 0, 0] } ] })"), Manifest, Error);
+
+	const FString ClaimDirectory = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("AnselBatchShards"), TEXT("Claims"));
+	TArray<FString> Reports;
+	TArray<FString> CapturedShots;
+	{
+		FAnselTestShard Coordinator(Manifest, ClaimDirectory, TEXT("0"));
+		Coordinator.Queue.ResetClaims();
+		FAnselTestShard Worker1(Manifest, ClaimDirectory, TEXT("1"));
+		TUniquePtr<FAnselTestShard> Worker2 = MakeUnique<FAnselTestShard>(Manifest, ClaimDirectory, TEXT("2"));
+
+		// each shard claims a shot on the first frame; then worker 2 dies with its shot in hand
+		Coordinator.Host.TickFrame(Coordinator.Scheduler);
+		Worker1.Host.TickFrame(Worker1.Scheduler);
+		Worker2->Host.TickFrame(Worker2->Scheduler);
+		TestTrue(TEXT("Worker 2 took a shot"), Worker2->Host.CapturedShots.Num() == 1);
+		CapturedShots.Append(Worker2->Host.CapturedShots);
+		Worker2.Reset();
+
+		for (int32 Frame = 0; Frame < 100 && !(Coordinator.Scheduler.IsFinished() && Worker1.Scheduler.IsFinished()); ++Frame)
+		{
+			Coordinator.Host.TickFrame(Coordinator.Scheduler);
+			Worker1.Host.TickFrame(Worker1.Scheduler);
+		}
+		TestTrue(TEXT("Live shards finish"), Coordinator.Scheduler.IsFinished() && Worker1.Scheduler.IsFinished());
+		TestEqual(TEXT("Live shards leave the dead one's shot"), Coordinator.Host.CapturedShots.Num() + Worker1.Host.CapturedShots.Num(), 5);
+		CapturedShots.Append(Coordinator.Host.CapturedShots);
+		CapturedShots.Append(Worker1.Host.CapturedShots);
+		Reports.Add(Coordinator.Scheduler.BuildReport());
+		Reports.Add(Worker1.Scheduler.BuildReport());
+
+		// the dead worker's heartbeat is still fresh, so its claim isn't up for grabs yet; the coordinator
+		// only relaunches a worker which exited cleanly once it is
+		TestTrue(TEXT("A shot is unfinished"), Coordinator.Queue.HasUnfinishedShots());
+		TestFalse(TEXT("A fresh claim isn't claimable"), Coordinator.Queue.HasClaimableShots());
+		const FString HeartbeatFilename = FPaths::Combine(ClaimDirectory, TEXT("Worker_2.heartbeat"));
+		IFileManager::Get().SetTimeStamp(*HeartbeatFilename, FDateTime::UtcNow() - FTimespan::FromMinutes(10.));
+		TestTrue(TEXT("A stale claim is claimable"), Coordinator.Queue.HasClaimableShots());
+
+		// relaunched under the same id, the worker takes its own claim straight back
+		FAnselTestShard Relaunched(Manifest, ClaimDirectory, TEXT("2"));
+		TestTrue(TEXT("Relaunched worker finishes"), Relaunched.Host.Run(Relaunched.Scheduler));
+		TestTrue(TEXT("Relaunched worker retakes its shot"), Relaunched.Host.CapturedShots.Num() == 1 && Relaunched.Host.CapturedShots[0] == CapturedShots[0]);
+		Reports.Add(Relaunched.Scheduler.BuildReport());
+		TestFalse(TEXT("Every shot is finished"), Coordinator.Queue.HasUnfinishedShots());
+	}
+	IFileManager::Get().DeleteDirectory(*FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("AnselBatchShards")), false, true);
+
+	// every shot was captured by exactly one live shard, apart from the one retaken after the crash
+	TSet<FString> UniqueShots(CapturedShots);
+	TestEqual(TEXT("Every shot captured"), UniqueShots.Num(), Manifest.Shots.Num());
+	TestEqual(TEXT("Only the dead worker's shot taken twice"), CapturedShots.Num(), Manifest.Shots.Num() + 1);
+
+	// the merged report has each shot from the shard which took it
+	TSharedPtr<FJsonObject> Merged;
+	TestTrue(TEXT("Merged report is JSON"), FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(FAnselBatchScheduler::MergeReports(Reports)), Merged) && Merged.IsValid());
+	if (!Merged.IsValid())
+	{
+		return true;
+	}
+	TestEqual(TEXT("Merged shards"), Merged->GetArrayField(TEXT("Shards")).Num(), 3);
+	const TArray<TSharedPtr<FJsonValue>>& Shots = Merged->GetArrayField(TEXT("Shots"));
+	TestEqual(TEXT("Merged shot count"), Shots.Num(), Manifest.Shots.Num());
+	for (const TSharedPtr<FJsonValue>& Shot : Shots)
+	{
+		const FString Name = Shot->AsObject()->GetStringField(TEXT("Name"));
+		TestEqual(FString::Printf(TEXT("%s status"), *Name), Shot->AsObject()->GetStringField(TEXT("Status")), FString(TEXT("Captured")));
+		if (Name == CapturedShots[0])
+		{
+			TestEqual(TEXT("Retaken shot is credited to the relaunch"), Shot->AsObject()->GetStringField(TEXT("Shard")), FString(TEXT("2")));
+		}
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,139 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselFrameSink.h"
+#include "Async/Async.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Guid.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static FString MakeTestRingName()
+{
+	return FString::Printf(TEXT("AnselTestFrames_%s"), *FGuid::NewGuid().ToString(EGuidFormats::Digits));
+}
+
+/** Drains a ring on its own thread, as a consumer process would, until the writer closes it */
+static TFuture<TArray<uint64>> StartReader(const FString& Name, TArray<FColor>& OutLastFrame)
+{
+	return Async(EAsyncExecution::Thread, [Name, &OutLastFrame]()
+	{
+		TArray<uint64> FrameNumbers;
+		TUniquePtr<FAnselFrameRingReader> Reader = FAnselFrameRingReader::Open(Name);
+		if (!Reader.IsValid())
+		{
+			return FrameNumbers;
+		}
+
+		for (;;)
+		{
+			// the closed flag is checked first, so a frame published just before closing isn't missed
+			const bool bWriterClosed = Reader->IsWriterClosed();
+			const bool bRead = Reader->Read([&FrameNumbers, &OutLastFrame](const FAnselFrameRingSlot& Slot, const FColor* Pixels)
+			{
+				FrameNumbers.Add(Slot.FrameNumber);
+				OutLastFrame.SetNumUninitialized(Slot.Width * Slot.Height);
+				FMemory::Memcpy(OutLastFrame.GetData(), Pixels, OutLastFrame.Num() * sizeof(FColor));
+			});
+			if (!bRead)
+			{
+				if (bWriterClosed)
+				{
+					break;
+				}
+				FPlatformProcess::YieldThread();
+			}
+		}
+		return FrameNumbers;
+	});
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselFrameRingDropTest, "Plugins.Ansel.FrameSink.Drop", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselFrameRingDropTest::RunTest(const FString& Parameters)
+{
+	const FString Name = MakeTestRingName();
+	const FIntPoint Size(16, 8);
+	TArray<FColor> Pixels;
+	Pixels.Init(FColor::Red, Size.X * Size.Y);
+
+	TUniquePtr<FAnselFrameRing> Ring = FAnselFrameRing::Create(Name, 2, Size, EAnselFrameRingPolicy::Drop, 0.);
+	TUniquePtr<FAnselFrameRingReader> Reader = FAnselFrameRingReader::Open(Name);
+	if (!TestTrue(TEXT("Ring and reader open"), Ring.IsValid() && Reader.IsValid()))
+	{
+		return true;
+	}
+
+	// a reader which doesn't keep up loses the frames after the ring fills, and gets them again once it reads
+	AddExpectedError(TEXT("dropped; the reader"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestTrue(TEXT("First frame fits"), Ring->Publish(Size.X, Size.Y, Pixels.GetData(), 0, 0.));
+	TestTrue(TEXT("Second frame fits"), Ring->Publish(Size.X, Size.Y, Pixels.GetData(), 1, 1. / 30.));
+	TestFalse(TEXT("Third frame is dropped"), Ring->Publish(Size.X, Size.Y, Pixels.GetData(), 2, 2. / 30.));
+	TestEqual(TEXT("Dropped count"), Ring->GetNumDropped(), uint64(1));
+
+	FAnselFrameRingSlot FirstSlot = {};
+	TestTrue(TEXT("Reads the oldest frame"), Reader->Read([&FirstSlot](const FAnselFrameRingSlot& Slot, const FColor* SlotPixels) { FirstSlot = Slot; }));
+	TestEqual(TEXT("Frame number is the shot index"), FirstSlot.FrameNumber, uint64(0));
+	TestTrue(TEXT("Size and format"), FirstSlot.Width == uint32(Size.X) && FirstSlot.Height == uint32(Size.Y) && FirstSlot.Format == EAnselFrameFormat::BGRA8);
+	TestTrue(TEXT("Fourth frame fits once a slot is free"), Ring->Publish(Size.X, Size.Y, Pixels.GetData(), 3, 3. / 30.));
+
+	FAnselFrameRingSlot SecondSlot = {};
+	Reader->Read([&SecondSlot](const FAnselFrameRingSlot& Slot, const FColor* SlotPixels) { SecondSlot = Slot; });
+	TestEqual(TEXT("Time is the shot's sequence time"), SecondSlot.TimeSeconds, 1. / 30.);
+
+	TestFalse(TEXT("Writer open"), Reader->IsWriterClosed());
+	Ring.Reset();
+	TestTrue(TEXT("Writer closed"), Reader->IsWriterClosed());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselFrameRingThroughputTest, "Plugins.Ansel.FrameSink.Throughput", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FAnselFrameRingThroughputTest::RunTest(const FString& Parameters)
+{
+	const FString Name = MakeTestRingName();
+	const FIntPoint Size(1920, 1080);
+	const int32 NumFrames = 120;
+
+	// a generous stall, so the benchmark measures the copies rather than losing frames to a slow machine
+	TUniquePtr<FAnselFrameRing> Ring = FAnselFrameRing::Create(Name, 4, Size, EAnselFrameRingPolicy::Stall, 1.);
+	if (!TestTrue(TEXT("Ring opens"), Ring.IsValid()))
+	{
+		return true;
+	}
+
+	TArray<FColor> LastFrame;
+	TFuture<TArray<uint64>> FrameNumbers = StartReader(Name, LastFrame);
+
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(Size.X * Size.Y);
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		Pixels[0] = FColor(uint8(Frame), 0, 0, 255);
+		Ring->Publish(Size.X, Size.Y, Pixels.GetData(), uint64(Frame), Frame / 30.);
+	}
+	const double PublishSeconds = FPlatformTime::Seconds() - StartTime;
+	const uint64 NumDropped = Ring->GetNumDropped();
+	Ring.Reset();
+
+	const TArray<uint64> Received = FrameNumbers.Get();
+	TestEqual(TEXT("Nothing dropped"), NumDropped, uint64(0));
+	TestEqual(TEXT("Every frame received"), Received.Num(), NumFrames);
+	for (int32 Index = 0; Index < Received.Num(); ++Index)
+	{
+		if (Received[Index] != uint64(Index))
+		{
+			AddError(FString::Printf(TEXT("Frame %d arrived as %llu"), Index, Received[Index]));
+			break;
+		}
+	}
+	TestTrue(TEXT("Last frame's pixels arrived"), LastFrame.Num() == Pixels.Num() && LastFrame[0] == Pixels[0]);
+
+	const double MegaBytes = double(NumFrames) * Size.X * Size.Y * sizeof(FColor) / (1024. * 1024.);
+	AddInfo(FString::Printf(TEXT("%d %dx%d frames in %.3fs: %.1f frames/s, %.0f MB/s"), NumFrames, Size.X, Size.Y, PublishSeconds,
+		NumFrames / PublishSeconds, MegaBytes / PublishSeconds));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,140 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselGradingLUT.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static FString GetTestLUTDirectory()
+{
+	return FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("AnselGradingLUT"));
+}
+
+/** Writes a Size^3 .cube file whose entry at each grid point is Function of that point's input colour */
+static FString WriteTestLUT(const FString& Name, int32 Size, TFunctionRef<FVector3f(const FVector3f&)> Function)
+{
+	FString Text = FString::Printf(TEXT("TITLE \"%s\"\n# generated by the Ansel tests\nLUT_3D_SIZE %d\n"), *Name, Size);
+	for (int32 B = 0; B < Size; ++B)
+	{
+		for (int32 G = 0; G < Size; ++G)
+		{
+			for (int32 R = 0; R < Size; ++R)
+			{
+				const FVector3f Output = Function(FVector3f(float(R), float(G), float(B)) / float(Size - 1));
+				Text += FString::Printf(TEXT("%.6f %.6f %.6f\n"), Output.X, Output.Y, Output.Z);
+			}
+		}
+	}
+
+	const FString Filename = FPaths::Combine(GetTestLUTDirectory(), Name + TEXT(".cube"));
+	FFileHelper::SaveStringToFile(Text, *Filename);
+	return Filename;
+}
+
+/** Every combination of a spread of levels on each channel, as a 1-row image */
+static TArray<FColor> MakeTestImage()
+{
+	static const uint8 Levels[] = { 0, 1, 37, 64, 127, 128, 200, 254, 255 };
+	TArray<FColor> Pixels;
+	for (uint8 R : Levels)
+	{
+		for (uint8 G : Levels)
+		{
+			for (uint8 B : Levels)
+			{
+				Pixels.Add(FColor(R, G, B, uint8(R ^ G ^ B)));
+			}
+		}
+	}
+	return Pixels;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselGradingLUTApplyTest, "Plugins.Ansel.GradingLUT.Apply", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselGradingLUTApplyTest::RunTest(const FString& Parameters)
+{
+	const TArray<FColor> Source = MakeTestImage();
+	const FIntPoint Size(Source.Num(), 1);
+
+	// graded pixels must be within Tolerance levels of Expected, with alpha untouched
+	auto TestGrade = [this, &Source, Size](const TCHAR* What, int32 LUTSize, TFunctionRef<FVector3f(const FVector3f&)> Function, int32 Tolerance)
+	{
+		FAnselGradingLUT LUT;
+		FString Error;
+		const bool bLoaded = LUT.LoadCubeFile(WriteTestLUT(What, LUTSize, Function), Error);
+		if (!TestTrue(FString::Printf(TEXT("%s loads: %s"), What, *Error), bLoaded))
+		{
+			return;
+		}
+		TestEqual(FString::Printf(TEXT("%s size"), What), LUT.GetSize(), LUTSize);
+
+		TArray<FColor> Graded;
+		Graded.SetNumUninitialized(Source.Num());
+		LUT.Apply(Source.GetData(), Graded.GetData(), Size);
+		for (int32 Index = 0; Index < Source.Num(); ++Index)
+		{
+			const FVector3f Expected = Function(FVector3f(Source[Index].R, Source[Index].G, Source[Index].B) / 255.f) * 255.f;
+			const FColor& Pixel = Graded[Index];
+			if (FMath::Abs(Pixel.R - Expected.X) > Tolerance || FMath::Abs(Pixel.G - Expected.Y) > Tolerance ||
+				FMath::Abs(Pixel.B - Expected.Z) > Tolerance || Pixel.A != Source[Index].A)
+			{
+				AddError(FString::Printf(TEXT("%s: %s graded to %s, expected %s"), What, *Source[Index].ToString(), *Pixel.ToString(), *Expected.ToString()));
+				return;
+			}
+		}
+	};
+
+	TestGrade(TEXT("Identity"), 2, [](const FVector3f& In) { return In; }, 1);
+	TestGrade(TEXT("Invert"), 2, [](const FVector3f& In) { return FVector3f(1.f) - In; }, 1);
+
+	// a channel swap moves every entry, so it shows up any mix-up in the table's axis order
+	TestGrade(TEXT("Swap"), 5, [](const FVector3f& In) { return FVector3f(In.Y, In.Z, In.X); }, 1);
+
+	// the full 33^3 table, not a 16^3 resampling of it, so a curve comes through to within a level or two
+	TestGrade(TEXT("Curve"), 33, [](const FVector3f& In) { return FVector3f(In.X * In.X, FMath::SmoothStep(0.f, 1.f, In.Y), In.Z * In.Z * In.Z); }, 2);
+
+	IFileManager::Get().DeleteDirectory(*GetTestLUTDirectory(), false, true);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselGradingLUTParseTest, "Plugins.Ansel.GradingLUT.Parse", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselGradingLUTParseTest::RunTest(const FString& Parameters)
+{
+	struct FBadLUT
+	{
+		const TCHAR* Name;
+		const TCHAR* Text;
+	};
+	static const FBadLUT BadLUTs[] =
+	{
+		{ TEXT("1D"), TEXT("LUT_1D_SIZE 2\n0 0 0\n1 1 1\n") },
+		{ TEXT("NoSize"), TEXT("0 0 0\n1 1 1\n") },
+		{ TEXT("TooFew"), TEXT("LUT_3D_SIZE 2\n0 0 0\n1 1 1\n") },
+		{ TEXT("BadDomain"), TEXT("LUT_3D_SIZE 2\nDOMAIN_MIN 1 1 1\nDOMAIN_MAX 0 0 0\n0 0 0\n1 0 0\n0 1 0\n1 1 0\n0 0 1\n1 0 1\n0 1 1\n1 1 1\n") },
+		{ TEXT("Junk"), TEXT("LUT_3D_SIZE 2\nnot a LUT\n") },
+	};
+
+	for (const FBadLUT& BadLUT : BadLUTs)
+	{
+		const FString Filename = FPaths::Combine(GetTestLUTDirectory(), FString(BadLUT.Name) + TEXT(".cube"));
+		FFileHelper::SaveStringToFile(BadLUT.Text, *Filename);
+
+		FAnselGradingLUT LUT;
+		FString Error;
+		TestFalse(FString::Printf(TEXT("%s is rejected"), BadLUT.Name), LUT.LoadCubeFile(Filename, Error));
+		TestFalse(FString::Printf(TEXT("%s says why"), BadLUT.Name), Error.IsEmpty());
+	}
+
+	FAnselGradingLUT LUT;
+	FString Error;
+	TestFalse(TEXT("Missing file is rejected"), LUT.LoadCubeFile(FPaths::Combine(GetTestLUTDirectory(), TEXT("Missing.cube")), Error));
+
+	IFileManager::Get().DeleteDirectory(*GetTestLUTDirectory(), false, true);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,73 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselImage.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselImageLanczosFlatTest, "Plugins.Ansel.Image.LanczosFlat", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselImageLanczosFlatTest::RunTest(const FString& Parameters)
+{
+	// a flat colour comes out unchanged, edges and all, and the size is rounded down
+	const FIntPoint SrcSize(100, 61);
+	const FColor Flat(30, 140, 220, 255);
+	TArray<FColor> Src;
+	Src.Init(Flat, SrcSize.X * SrcSize.Y);
+
+	TArray<FColor> Dst;
+	FIntPoint DstSize;
+	AnselImage::DownsampleLanczos3(Src.GetData(), SrcSize, 3, Dst, DstSize);
+
+	TestEqual(TEXT("Width"), DstSize.X, 33);
+	TestEqual(TEXT("Height"), DstSize.Y, 20);
+	TestEqual(TEXT("Pixel count"), Dst.Num(), 33 * 20);
+	for (const FColor& Pixel : Dst)
+	{
+		if (FMath::Abs(Pixel.R - Flat.R) > 1 || FMath::Abs(Pixel.G - Flat.G) > 1 || FMath::Abs(Pixel.B - Flat.B) > 1)
+		{
+			AddError(FString::Printf(TEXT("Flat colour changed to %s"), *Pixel.ToString()));
+			break;
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselImageLanczosCheckerTest, "Plugins.Ansel.Image.LanczosChecker", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselImageLanczosCheckerTest::RunTest(const FString& Parameters)
+{
+	// a pixel checkerboard halved averages in linear light, to 50% grey rather than sRGB level 128
+	const FIntPoint SrcSize(64, 64);
+	TArray<FColor> Src;
+	Src.SetNumUninitialized(SrcSize.X * SrcSize.Y);
+	for (int32 Y = 0; Y < SrcSize.Y; ++Y)
+	{
+		for (int32 X = 0; X < SrcSize.X; ++X)
+		{
+			Src[Y * SrcSize.X + X] = ((X + Y) & 1) ? FColor::White : FColor::Black;
+		}
+	}
+
+	TArray<FColor> Dst;
+	FIntPoint DstSize;
+	AnselImage::DownsampleLanczos3(Src.GetData(), SrcSize, 2, Dst, DstSize);
+
+	// the border is left out, as clamping at the edges tips the balance of the taps
+	const FColor Expected = FLinearColor(0.5f, 0.5f, 0.5f).ToFColorSRGB();
+	for (int32 Y = 3; Y < DstSize.Y - 3; ++Y)
+	{
+		for (int32 X = 3; X < DstSize.X - 3; ++X)
+		{
+			const FColor& Pixel = Dst[Y * DstSize.X + X];
+			if (FMath::Abs(Pixel.R - Expected.R) > 1)
+			{
+				AddError(FString::Printf(TEXT("Pixel %d,%d is %s, not %s"), X, Y, *Pixel.ToString(), *Expected.ToString()));
+				return true;
+			}
+		}
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
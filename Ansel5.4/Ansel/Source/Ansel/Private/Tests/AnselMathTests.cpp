@@ -0,0 +1,94 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AnselMath.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// the threshold FNVAnselCameraPhotographyPrivate::RebaseAnselCameraOrigin uses
+static const float TestMaxCameraOffset = 65536.f;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselMathRebaseTest, "Plugins.Ansel.Math.RebaseFarFromOrigin", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselMathRebaseTest::RunTest(const FString& Parameters)
+{
+	// a camera flown a long way from a session started 100km out, in steps floats hold exactly, so any
+	// error is the rebasing's own
+	for (const double Sign : { 1., -1. })
+	{
+		const FVector Start(Sign * 1e7, -Sign * 1e7, Sign * 1e7);
+		const FVector Step(12.5, -7.25, 0.5);
+		const int32 NumSteps = 20000;
+
+		FVector Origin = Start;
+		nv::Vec3 Position = AnselMath::WorldToPosition(Start, Origin);
+		int32 NumRebases = 0;
+		for (int32 Index = 0; Index < NumSteps; ++Index)
+		{
+			Position.x += float(Step.X);
+			Position.y += float(Step.Y);
+			Position.z += float(Step.Z);
+			NumRebases += AnselMath::RebaseOrigin(Position, Origin, TestMaxCameraOffset) ? 1 : 0;
+			TestTrue(TEXT("Position stays within the offset"), FVector(Position.x, Position.y, Position.z).GetAbsMax() <= TestMaxCameraOffset);
+		}
+
+		const FVector Expected = Start + Step * NumSteps;
+		const FVector Actual = AnselMath::PositionToWorld(Position, Origin);
+		TestTrue(TEXT("Origin was rebased"), NumRebases > 0);
+		TestTrue(FString::Printf(TEXT("Position within 0.01cm at %s (is %s)"), *Expected.ToString(), *Actual.ToString()), Actual.Equals(Expected, 0.01));
+	}
+
+	// a world position 100km out round trips through the SDK's floats to well under a millimetre
+	const FVector World(1e7 + 0.123, -1e7 - 0.456, 1e7 + 0.789);
+	const FVector Origin = World - FVector(10., 20., 30.);
+	const FVector RoundTrip = AnselMath::PositionToWorld(AnselMath::WorldToPosition(World, Origin), Origin);
+	TestTrue(TEXT("Round trip within 0.01cm"), RoundTrip.Equals(World, 0.01));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselMathViewOverrideTest, "Plugins.Ansel.Math.ViewOverride", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselMathViewOverrideTest::RunTest(const FString& Parameters)
+{
+	// two batch shots which differ only in location: each scripted view moves the origin onto itself, as
+	// FNVAnselCameraPhotographyPrivate does, so the SDK camera is the same for both
+	const FVector ShotLocations[] = { FVector(1000., 2000., 300.), FVector(-5000., 40., 300.) };
+	const FRotator ShotRotation(-10.f, 45.f, 0.f);
+	ansel::Camera Cameras[2] = {};
+	for (int32 Shot = 0; Shot < 2; ++Shot)
+	{
+		Cameras[Shot].position = AnselMath::WorldToPosition(ShotLocations[Shot], ShotLocations[Shot]);
+		Cameras[Shot].rotation = AnselMath::WorldToRotation(ShotRotation);
+		Cameras[Shot].fov = 60.f;
+	}
+
+	TestTrue(TEXT("SDK cameras alone can't tell the shots apart"), AnselMath::CamerasMatch(Cameras[0], Cameras[1]));
+	TestFalse(TEXT("The second shot is a new view"), AnselMath::ViewsMatch(Cameras[1], ShotLocations[1], Cameras[0], ShotLocations[0]));
+	TestTrue(TEXT("An untouched camera is the same view"), AnselMath::ViewsMatch(Cameras[1], ShotLocations[1], Cameras[1], ShotLocations[1]));
+	TestTrue(TEXT("Each shot renders from its own location"),
+		AnselMath::PositionToWorld(Cameras[0].position, ShotLocations[0]).Equals(ShotLocations[0]) &&
+		AnselMath::PositionToWorld(Cameras[1].position, ShotLocations[1]).Equals(ShotLocations[1]));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselMathRotationTest, "Plugins.Ansel.Math.Rotation", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselMathRotationTest::RunTest(const FString& Parameters)
+{
+	const FRotator Rotation(-10.f, 90.f, 5.f);
+	TestTrue(TEXT("Rotation round trips"), AnselMath::RotationToWorld(AnselMath::WorldToRotation(Rotation)).Equals(Rotation, 0.01f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnselMathSliderTest, "Plugins.Ansel.Math.Slider", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnselMathSliderTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("Slider 0 is Min"), AnselMath::SliderToValue(0.f, -2.f, 6.f), -2.f);
+	TestEqual(TEXT("Slider 1 is Max"), AnselMath::SliderToValue(1.f, -2.f, 6.f), 6.f);
+	TestEqual(TEXT("Value round trips"), AnselMath::SliderToValue(AnselMath::ValueToSlider(1.5f, -2.f, 6.f), -2.f, 6.f), 1.5f, UE_KINDA_SMALL_NUMBER);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
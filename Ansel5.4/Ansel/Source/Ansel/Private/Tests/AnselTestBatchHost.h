@@ -0,0 +1,125 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnselBatchCapture.h"
+#include "AnselSessionEvents.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Stands in for the engine and the photography provider behind a batch scheduler: the session starts as
+ * soon as it's asked for, views settle at once, every capture is done by the next tick and time moves on
+ * by a fixed step per frame, so a whole batch runs synchronously inside a test.
+ */
+class FAnselTestBatchHost : public IAnselBatchHost
+{
+public:
+	virtual bool IsReady() const override { return bReady; }
+	virtual void StartSession() override { bSessionActive = true; bSessionStartPending = true; }
+	virtual void StopSession() override { bSessionActive = false; }
+
+	virtual void SetShotView(const FAnselBatchShot& Shot) override
+	{
+		ViewShots.Add(Shot.Name);
+		ViewLocations.Add(Shot.Location);
+		ViewChangedFrame = SessionFrames;
+	}
+
+	virtual bool StartCapture(const FAnselBatchShot& Shot, const FString& Filename) override
+	{
+		CapturedShots.Add(Shot.Name);
+		CapturedFilenames.Add(Filename);
+		return true;
+	}
+	virtual bool IsCaptureInProgress() const override { return false; }
+	virtual bool ContinueCapture() override { return false; }
+	virtual FAnselAccumulationStats GetCaptureStats() const override { return FAnselAccumulationStats(); }
+	virtual bool WasCaptureDropped() const override { return bDropCaptures; }
+
+	virtual bool CanAffordCapture(const FAnselBatchShot& Shot, FString& OutReason) const override
+	{
+		if (Shot.Resolution.X > MaxCaptureSize || Shot.Resolution.Y > MaxCaptureSize)
+		{
+			OutReason = TEXT("too big for the test host");
+			return false;
+		}
+		return true;
+	}
+
+	/** Each step draws on the engine's random streams, as gameplay ticking would */
+	virtual bool StepWorld(int32 NumSteps) override
+	{
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			StepRands.Add(FMath::Rand());
+			StepSRands.Add(FMath::SRand());
+		}
+		WorldSteps += NumSteps;
+		return true;
+	}
+	virtual bool IsSteppingWorld() const override { return false; }
+
+	virtual void SetFrameSink(FAnselFrameRing* FrameSink) override {}
+
+	virtual double GetTimeSeconds() const override { return TimeSeconds; }
+	virtual int32 GetDefaultSettleFrames() const override { return 0; }
+
+	virtual void GetMemoryUsage(uint64& OutUsedPhysical, uint64& OutUsedGPU) const override
+	{
+		OutUsedPhysical = 0;
+		OutUsedGPU = 0;
+	}
+
+	/** Drives the scheduler through one frame, the way FAnselBatchRunner and the provider do between them */
+	void TickFrame(FAnselBatchScheduler& Scheduler)
+	{
+		Scheduler.Tick();
+		if (bSessionStartPending)
+		{
+			bSessionStartPending = false;
+			Scheduler.HandleSessionStarted();
+		}
+		if (bSessionActive)
+		{
+			FAnselSessionFrame SessionFrame;
+			SessionFrame.FramesSinceSessionStart = ++SessionFrames;
+			SessionFrame.FramesSinceViewChanged = SessionFrames - ViewChangedFrame;
+			Scheduler.HandleSessionFrame(SessionFrame);
+		}
+		TimeSeconds += FrameSeconds;
+	}
+
+	/** Returns whether the batch finished within MaxFrames */
+	bool Run(FAnselBatchScheduler& Scheduler, int32 MaxFrames = 1000)
+	{
+		for (int32 Frame = 0; Frame < MaxFrames && !Scheduler.IsFinished(); ++Frame)
+		{
+			TickFrame(Scheduler);
+		}
+		return Scheduler.IsFinished();
+	}
+
+	bool bReady = true;
+	int32 MaxCaptureSize = MAX_int32;
+	bool bDropCaptures = false;
+	double FrameSeconds = 1. / 60.;
+
+	TArray<FString> ViewShots;
+	TArray<FVector> ViewLocations;
+	TArray<FString> CapturedShots;
+	TArray<FString> CapturedFilenames;
+	int32 WorldSteps = 0;
+	TArray<int32> StepRands;
+	TArray<float> StepSRands;
+
+private:
+	bool bSessionActive = false;
+	bool bSessionStartPending = false;
+	uint32 SessionFrames = 0;
+	uint32 ViewChangedFrame = 0; // every scripted view counts as a change, as it does in the provider
+	double TimeSeconds = 0.;
+};
+
+#endif // WITH_DEV_AUTOMATION_TESTS
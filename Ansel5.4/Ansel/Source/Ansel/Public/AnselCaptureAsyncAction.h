@@ -0,0 +1,95 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "Containers/Ticker.h"
+#include "AnselFunctionLibrary.h"
+#include "AnselCaptureAsyncAction.generated.h"
+
+struct FAnselSessionFrame;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAnselCaptureAsyncActionEvent, int32, Frames);
+
+/**
+ * Latent photography nodes which follow the session and capture state, so Blueprints don't need to poll
+ * for them.  Each node starts a photography session if one isn't already running.  Super-resolution
+ * captures are taken by the node itself; the SDK only takes 360 captures from its overlay.
+ */
+UCLASS()
+class ANSEL_API UAnselCaptureAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	/** Every frame while waiting: frames since the capture started, or frames settled so far */
+	UPROPERTY(BlueprintAssignable)
+	FAnselCaptureAsyncActionEvent OnProgress;
+
+	/** The capture finished, or the view settled; carries the number of frames it took */
+	UPROPERTY(BlueprintAssignable)
+	FAnselCaptureAsyncActionEvent OnCompleted;
+
+	/** Photography is unavailable, the session ended first, or the timeout expired */
+	UPROPERTY(BlueprintAssignable)
+	FAnselCaptureAsyncActionEvent OnFailed;
+
+	/**
+	 * Once the session's view has settled for r.Photography.SettleFrames, takes a still of it at Multiplier
+	 * times the viewport's size, without the overlay.  An empty Filename writes a timestamped PNG to the
+	 * screenshot directory.  A TimeoutSeconds of 0 waits indefinitely.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Photography", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UAnselCaptureAsyncAction* CaptureSuperResolution(UObject* WorldContextObject, int32 Multiplier = 2, const FString& Filename = TEXT(""), float TimeoutSeconds = 0.f, bool bStopSessionWhenDone = false);
+
+	/** Waits for someone to take a 360 capture in the photography overlay.  A TimeoutSeconds of 0 waits indefinitely. */
+	UFUNCTION(BlueprintCallable, Category = "Photography", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UAnselCaptureAsyncAction* WaitFor360Capture(UObject* WorldContextObject, bool bStereo = false, float TimeoutSeconds = 0.f, bool bStopSessionWhenDone = false);
+
+	/**
+	 * Waits until neither the photography camera nor any photography setting has changed for SettleFrames
+	 * consecutive frames, i.e. temporal effects and streaming have had time to converge.  A negative
+	 * SettleFrames uses r.Photography.SettleFrames.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Photography", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UAnselCaptureAsyncAction* WaitForQualityConverged(UObject* WorldContextObject, int32 SettleFrames = -1, float TimeoutSeconds = 0.f);
+
+	virtual void Activate() override;
+
+private:
+	enum class EWaitFor : uint8
+	{
+		SuperResolutionCapture,
+		OverlayCapture,
+		QualityConverged
+	};
+
+	static UAnselCaptureAsyncAction* Create(UObject* WorldContextObject, EWaitFor WaitFor, float TimeoutSeconds);
+
+	void HandleSessionEnded();
+	void HandleCaptureStarted(EAnselCaptureType StartedCaptureType);
+	void HandleCaptureEnded(EAnselCaptureType EndedCaptureType);
+	void HandleSessionFrame(const FAnselSessionFrame& Frame);
+	bool HandleTimeout(float DeltaTime);
+
+	void Finish(bool bSucceeded, int32 Frames);
+
+	TWeakObjectPtr<UObject> WorldContext;
+	EWaitFor WaitFor = EWaitFor::OverlayCapture;
+	EAnselCaptureType CaptureType = EAnselCaptureType::SuperResolution;
+	int32 Multiplier = 2;
+	FString Filename;
+	int32 SettleFrames = 0;
+	float TimeoutSeconds = 0.f;
+	bool bStopSessionWhenDone = false;
+
+	bool bCaptureStarted = false;
+	int32 CaptureFrames = 0;
+	bool bFinished = false;
+
+	FDelegateHandle SessionEndedHandle;
+	FDelegateHandle CaptureStartedHandle;
+	FDelegateHandle CaptureEndedHandle;
+	FDelegateHandle SessionFrameHandle;
+	FTSTicker::FDelegateHandle TimeoutHandle;
+};
@@ -14,6 +14,16 @@ enum EUIControlEffectTarget
 	MotionBlur
 };
 
+/** The kinds of multi-part capture which the photography overlay can take */
+UENUM(BlueprintType)
+enum class EAnselCaptureType : uint8
+{
+	Mono360,
+	Stereo360,
+	SuperResolution,
+	Stereo
+};
+
 UCLASS()
 class ANSEL_API UAnselFunctionLibrary : public UBlueprintFunctionLibrary
 {
@@ -0,0 +1,37 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnselFunctionLibrary.h"
+
+/** Where an active photography session has got to, as of the current frame */
+struct FAnselSessionFrame
+{
+	uint32 FramesSinceSessionStart = 0;
+
+	/** Frames since the current capture started; 0 if no capture is in progress */
+	uint32 FramesSinceCaptureStart = 0;
+	bool bCaptureActive = false;
+
+	/** Consecutive frames in which neither the camera nor any photography setting has changed */
+	uint32 FramesSinceViewChanged = 0;
+};
+
+/**
+ * Photography session and capture notifications.  Everything is broadcast on the game thread, from the
+ * photography camera update, so listeners can drive gameplay directly.
+ */
+struct FAnselSessionEvents
+{
+	FSimpleMulticastDelegate OnSessionStarted;
+	FSimpleMulticastDelegate OnSessionEnded;
+	TMulticastDelegate<void(EAnselCaptureType)> OnCaptureStarted;
+	TMulticastDelegate<void(EAnselCaptureType)> OnCaptureEnded;
+
+	/** Every frame of an active session, after the photography camera has been updated */
+	TMulticastDelegate<void(const FAnselSessionFrame&)> OnSessionFrame;
+
+	bool bSessionActive = false;
+	bool bCaptureActive = false;
+};
@@ -0,0 +1,58 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** The kind of widget a control shows in the 'Game Settings' part of the Ansel overlay */
+enum class EAnselUserControlType : uint8
+{
+	Slider,
+	Bool
+};
+
+/** What a control in the Ansel overlay drives */
+enum class EAnselUserControlTarget : uint8
+{
+	/** A float or bool member of FPostProcessSettings, named by TargetName; its bOverride_ flag is raised while the control is shown */
+	PostProcess,
+	/** A console variable named by TargetName; its value from session start is restored when the session ends */
+	ConsoleVariable,
+	/** OnValueChanged is called on the game thread with the control's value */
+	Callback
+};
+
+/**
+ * Describes a control to add to the Ansel overlay.  Controls are registered with IAnselModule, or
+ * declared in the [Ansel.UserControls] section of Game.ini, e.g.
+ *
+ *   +Controls=(Name=VignetteIntensity, Label="Vignette", Type=Slider, Target=PostProcess, TargetName=VignetteIntensity, Min=0, Max=2, EffectGroup=-1, RequiresActive=VignetteIntensity)
+ */
+struct FAnselUserControlDesc
+{
+	/** Unique key; registering a second control with the same name replaces the first */
+	FName Name;
+
+	FText Label;
+
+	EAnselUserControlType Type = EAnselUserControlType::Slider;
+	EAnselUserControlTarget Target = EAnselUserControlTarget::PostProcess;
+
+	/** FPostProcessSettings member or console variable name, depending on Target */
+	FName TargetName;
+
+	/** Range a slider maps onto; ignored for bools */
+	float Min = 0.f;
+	float Max = 1.f;
+
+	/** Initial value for Callback targets; PostProcess and ConsoleVariable targets start from their current value */
+	float DefaultValue = 0.f;
+
+	/** If set, the control is only shown while this EUIControlEffectTarget is allowed (see UAnselFunctionLibrary::SetUIControlVisibility) */
+	int32 EffectGroup = INDEX_NONE;
+
+	/** The control is hidden for a session if any of these FPostProcessSettings members is <= 0 at session start */
+	TArray<FName> RequiresActive;
+
+	TFunction<void(float)> OnValueChanged;
+};
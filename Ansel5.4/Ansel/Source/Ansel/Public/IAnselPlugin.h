@@ -5,6 +5,9 @@
 #include "Modules/ModuleManager.h"
 #include "CameraPhotographyModule.h"
 
+struct FAnselUserControlDesc;
+struct FAnselSessionEvents;
+
 /**
  * The public interface to this module.  In most cases, this interface is only public to sibling modules 
  * within this plugin.
@@ -34,5 +37,30 @@ public:
 	{
 		return FModuleManager::Get().IsModuleLoaded( "Ansel" );
 	}
-};
 
+	/**
+	 * Adds a control to the 'Game Settings' part of the Ansel overlay, replacing any control with the same name.
+	 * Takes effect from the next photography session.  Must be called on the game thread.
+	 */
+	virtual void RegisterUserControl(const FAnselUserControlDesc& Desc) = 0;
+
+	/** Removes a control previously added with RegisterUserControl.  Must be called on the game thread. */
+	virtual void UnregisterUserControl(FName Name) = 0;
+
+	/** Notifications of photography sessions and captures as they happen; see AnselSessionEvents.h */
+	virtual FAnselSessionEvents& GetSessionEvents() = 0;
+
+	/**
+	 * Takes a super-resolution still of the photography session's current view at Multiplier times the
+	 * viewport's size, through the engine's high resolution screenshot, so no one has to be at the overlay.
+	 * An empty Filename writes a timestamped PNG to the screenshot directory.  Returns false, and says why in OutError, if
+	 * the capture can't be started now.  Must be called on the game thread.
+	 */
+	virtual bool StartSuperResolutionCapture(int32 Multiplier, const FString& Filename, FString& OutError) = 0;
+
+	/** Whether the capture StartSuperResolutionCapture started is still being taken */
+	virtual bool IsSuperResolutionCaptureInProgress() = 0;
+
+	/** r.Photography.SettleFrames: how many frames temporal effects and streaming get to converge after the view changes */
+	virtual int32 GetSettleFrames() const = 0;
+};